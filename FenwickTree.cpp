@@ -1,35 +1,519 @@
 #include <vector>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <stdexcept>
+#include <cstdint>
+#include <system_error>
+#include <type_traits>
+#include <utility>
 
+#include <sys/mman.h>
+
+// Integer modulo MOD, for counts that only matter modulo a prime
+template<uint32_t MOD>
+struct Modular {
+    uint32_t value = 0;
+
+    Modular() = default;
+    Modular(long long v) : value(static_cast<uint32_t>(((v % MOD) + MOD) % MOD)) {}
+    Modular& operator+=(Modular other) {
+        value += other.value;
+        if (value >= MOD) {
+            value -= MOD;
+        }
+        return *this;
+    }
+    Modular& operator-=(Modular other) {
+        value += MOD - other.value;
+        if (value >= MOD) {
+            value -= MOD;
+        }
+        return *this;
+    }
+    Modular& operator*=(Modular other) {
+        value = static_cast<uint32_t>(static_cast<uint64_t>(value) * other.value % MOD);
+        return *this;
+    }
+    friend Modular operator+(Modular a, Modular b) { return a += b; }
+    friend Modular operator-(Modular a, Modular b) { return a -= b; }
+    friend Modular operator*(Modular a, Modular b) { return a *= b; }
+    friend bool operator==(Modular a, Modular b) { return a.value == b.value; }
+};
+
+// Low-bit traversal shared by the Fenwick trees below, on 1-indexed positions.
+// fenwickUp visits the nodes covering position i, for updates;
+// fenwickDown visits the nodes whose ranges make up the prefix 1..i, for queries.
+template<typename Fn>
+inline void fenwickUp(int i, int n, Fn fn) {
+    for (; i <= n; i += i & -i) {
+        fn(i);
+    }
+}
+template<typename Fn>
+inline void fenwickDown(int i, Fn fn) {
+    for (; i > 0; i -= i & -i) {
+        fn(i);
+    }
+}
+// Turns per-position values in tree[1..n] into Fenwick partial sums in O(n)
+template<typename Tree, typename Add>
+inline void fenwickBuild(Tree& tree, int n, Add add) {
+    for (int i = 1; i <= n; i++) {
+        int parent = i + (i & -i);
+        if (parent <= n) {
+            add(tree[parent], tree[i]);
+        }
+    }
+}
+
+// Fenwick tree over T (long long by default, also double or Modular).
+// Built from a vector of any type convertible to T; FenwickTree ft(nums) on ints
+// gives a long long tree, so sums of large counters do not overflow.
+template<typename T = long long>
 class FenwickTree {
 private:
-std::vector<int> tree;
+std::vector<T> tree;
 int n;
 public:
-    FenwickTree(const std::vector<int>& nums) : tree(nums.size()+1), n(nums.size()) {
-        for (int i = 0; i < n; i++) {
-            update(i, nums[i]);
+    // Builds the tree in O(n): each node adds its partial sum into its parent
+    template<typename U>
+    FenwickTree(const std::vector<U>& nums) : tree(nums.size()+1), n(nums.size()) {
+        for (int i = 1; i <= n; i++) {
+            tree[i] = static_cast<T>(nums[i - 1]);
         }
+        fenwickBuild(tree, n, [](T& parent, const T& child) { parent += child; });
     }
     // Updates the Fenwick tree to reflect a change in the original array
-    void update(int i, int delta) {
+    void update(int i, T delta) {
         // Tree is 1-ied array
-        i++;
-        while (i <= n) {
-            tree[i] += delta;
-            i += i & -i;
+        fenwickUp(i + 1, n, [&](int node) { tree[node] += delta; });
+    }
+    // Computes the prefix sum up to element i (clamped to the array)
+    T query(int i) const {
+        T sum{};
+        fenwickDown(std::min(i + 1, n), [&](int node) { sum += tree[node]; });
+        return sum;
+    }
+    // Computes the sum of elements l through r
+    T rangeQuery(int l, int r) const {
+        if (l > r) {
+            return T{};
+        }
+        return query(r) - query(l - 1);
+    }
+    // Returns the first index i with query(i) >= target, or size() if there is none.
+    // Needs every element to be non-negative, so that prefix sums only grow.
+    // Walks down from the highest power of two, like a binary search over the tree.
+    int lower_bound(T target) const requires std::totally_ordered<T> {
+        int pos = 0;
+        for (int step = std::bit_floor(static_cast<unsigned>(n)); step > 0; step >>= 1) {
+            if (pos + step <= n && tree[pos + step] < target) {
+                pos += step;
+                target -= tree[pos];
+            }
+        }
+        return pos;
+    }
+    int size() const {
+        return n;
+    }
+};
+
+// Integer input sums into long long; anything else keeps its own type
+template<typename U>
+FenwickTree(const std::vector<U>&) -> FenwickTree<std::conditional_t<std::is_integral_v<U>, long long, U>>;
+
+// Range add with range sum, using two Fenwick trees over the difference array d:
+// prefix(p) = p * sum(d[1..p]) - sum(d[j] * (j - 1)). Both trees are interleaved so
+// one traversal reads a single cache line per node instead of two.
+template<typename T = long long>
+class RangeFenwickTree {
+private:
+struct Node {
+    T diff{};        // sums of d[j]
+    T weighted{};    // sums of d[j] * (j - 1)
+};
+std::vector<Node> tree;
+int n;
+    void add(int p, T delta) {
+        T weighted = delta * static_cast<T>(p - 1);
+        fenwickUp(p, n, [&](int node) {
+            tree[node].diff += delta;
+            tree[node].weighted += weighted;
+        });
+    }
+    T prefix(int p) const {
+        T diff{};
+        T weighted{};
+        fenwickDown(p, [&](int node) {
+            diff += tree[node].diff;
+            weighted += tree[node].weighted;
+        });
+        return diff * static_cast<T>(p) - weighted;
+    }
+public:
+    RangeFenwickTree(int n) : tree(std::max(n, 0) + 1), n(std::max(n, 0)) {}
+    // Builds from the difference array in O(n)
+    template<typename U>
+    RangeFenwickTree(const std::vector<U>& nums) : tree(nums.size()+1), n(nums.size()) {
+        T previous{};
+        for (int i = 1; i <= n; i++) {
+            T value = static_cast<T>(nums[i - 1]);
+            tree[i].diff = value - previous;
+            tree[i].weighted = tree[i].diff * static_cast<T>(i - 1);
+            previous = value;
+        }
+        fenwickBuild(tree, n, [](Node& parent, const Node& child) {
+            parent.diff += child.diff;
+            parent.weighted += child.weighted;
+        });
+    }
+    // Adds delta to every element l through r
+    void rangeAdd(int l, int r, T delta) {
+        if (l > r) {
+            return;
+        }
+        add(l + 1, delta);
+        add(r + 2, T{} - delta);
+    }
+    void update(int i, T delta) {
+        rangeAdd(i, i, delta);
+    }
+    // Computes the prefix sum up to element i (clamped to the array)
+    T query(int i) const {
+        return prefix(std::min(i + 1, n));
+    }
+    T rangeQuery(int l, int r) const {
+        if (l > r) {
+            return T{};
+        }
+        return query(r) - query(l - 1);
+    }
+    int size() const {
+        return n;
+    }
+};
+
+template<typename U>
+RangeFenwickTree(const std::vector<U>&) -> RangeFenwickTree<std::conditional_t<std::is_integral_v<U>, long long, U>>;
+
+// 2D Fenwick tree for rectangle sums, stored row-major in one flat array of
+// (rows + 1) x (cols + 1) nodes. The inner column walk stays within one row.
+template<typename T = long long>
+class FenwickTree2D {
+private:
+std::vector<T> tree;
+int rows;
+int cols;
+    T& at(int r, int c) {
+        return tree[static_cast<size_t>(r) * (cols + 1) + c];
+    }
+    const T& at(int r, int c) const {
+        return tree[static_cast<size_t>(r) * (cols + 1) + c];
+    }
+public:
+    FenwickTree2D(int rows, int cols) : rows(std::max(rows, 0)), cols(std::max(cols, 0)) {
+        tree.resize(static_cast<size_t>(this->rows + 1) * (this->cols + 1));
+    }
+    // Builds in O(rows * cols): partial sums along each row, then rows into parent rows
+    template<typename U>
+    FenwickTree2D(const std::vector<std::vector<U>>& grid) : FenwickTree2D(grid.size(), grid.empty() ? 0 : grid[0].size()) {
+        for (int r = 1; r <= rows; r++) {
+            if ((int)grid[r - 1].size() != cols) {
+                throw std::invalid_argument("FenwickTree2D grid rows must all have the same length");
+            }
+            T* row = &at(r, 0);
+            for (int c = 1; c <= cols; c++) {
+                row[c] = static_cast<T>(grid[r - 1][c - 1]);
+            }
+            fenwickBuild(row, cols, [](T& parent, const T& child) { parent += child; });
+        }
+        for (int r = 1; r <= rows; r++) {
+            int parent = r + (r & -r);
+            if (parent <= rows) {
+                T* to = &at(parent, 0);
+                const T* from = &at(r, 0);
+                for (int c = 1; c <= cols; c++) {
+                    to[c] += from[c];
+                }
+            }
+        }
+    }
+    void update(int r, int c, T delta) {
+        fenwickUp(r + 1, rows, [&](int row) {
+            T* line = &at(row, 0);
+            fenwickUp(c + 1, cols, [&](int col) { line[col] += delta; });
+        });
+    }
+    // Computes the sum of the rectangle [0, r] x [0, c] (clamped to the grid)
+    T query(int r, int c) const {
+        T sum{};
+        int lastCol = std::min(c + 1, cols);
+        fenwickDown(std::min(r + 1, rows), [&](int row) {
+            const T* line = &at(row, 0);
+            fenwickDown(lastCol, [&](int col) { sum += line[col]; });
+        });
+        return sum;
+    }
+    // Computes the sum of the rectangle [r1, r2] x [c1, c2]
+    T rangeQuery(int r1, int c1, int r2, int c2) const {
+        if (r1 > r2 || c1 > c2) {
+            return T{};
+        }
+        return query(r2, c2) - query(r1 - 1, c2) - query(r2, c1 - 1) + query(r1 - 1, c1 - 1);
+    }
+    int numRows() const {
+        return rows;
+    }
+    int numCols() const {
+        return cols;
+    }
+};
+
+// Fenwick tree for counters that many threads update at once, without a lock.
+// - update does a relaxed atomic fetch_add on each node it touches.
+// - query(i) reads the nodes with relaxed atomic loads. For j <= i, exactly one node on
+//   the query path covers j, so a prefix query counts each concurrent update either
+//   entirely or not at all, and always counts the updates that finished before it started.
+//   With non-negative deltas, the prefix sums a thread reads never go down.
+// - rangeQuery(l, r) is two prefix queries, so an update at or before l - 1 that runs
+//   during it can be counted in one of them only.
+// - with shards > 1, each thread adds into one of `shards` separate trees, picked
+//   once per thread, and a query sums over all of them. Writers then rarely share
+//   a cache line, at the cost of shards times the query work.
+template<typename T = long long>
+    requires std::integral<T>
+class ConcurrentFenwickTree {
+private:
+    static_assert(std::atomic_ref<T>::is_always_lock_free, "Counters must be lock-free atomics");
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T> tree;
+    int n;
+    int shards;
+    // Nodes per shard, rounded up to whole cache lines so shards never share one
+    size_t stride;
+    // Index where shard 0 starts, the first cache line boundary in tree
+    size_t first;
+
+    // Shard for the calling thread: threads take consecutive slots the first time they ask
+    int shardOfThisThread() const {
+        static std::atomic<unsigned> nextSlot = 0;
+        thread_local unsigned slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+        return slot % shards;
+    }
+    T prefix(int p) const {
+        T sum = 0;
+        for (int s = 0; s < shards; s++) {
+            const T* shard = &tree[first + s * stride];
+            fenwickDown(p, [&](int node) {
+                sum += std::atomic_ref<T>(const_cast<T&>(shard[node])).load(std::memory_order_relaxed);
+            });
         }
+        return sum;
     }
-    // Computes the prefix sum up to element i
-    long query(int i) {
-        i++;
-        long sum = 0;
-        while (i > 0) {
-            sum += tree[i];
-            i -= i & -i;
+public:
+    // Builds nums into shard 0 in O(n); the other shards start at zero
+    template<typename U>
+    ConcurrentFenwickTree(const std::vector<U>& nums, int shards = 1) : n(nums.size()), shards(std::max(shards, 1)) {
+        constexpr size_t perLine = CACHE_LINE / sizeof(T);
+        stride = (n + perLine) / perLine * perLine;
+        tree.resize(stride * this->shards + perLine);
+        first = (CACHE_LINE - reinterpret_cast<uintptr_t>(tree.data()) % CACHE_LINE) % CACHE_LINE / sizeof(T);
+        T* shard = &tree[first];
+        for (int i = 1; i <= n; i++) {
+            shard[i] = static_cast<T>(nums[i - 1]);
+        }
+        fenwickBuild(shard, n, [](T& parent, const T& child) { parent += child; });
+    }
+    // Adds delta to element i. Safe to call from any thread.
+    void update(int i, T delta) {
+        T* shard = &tree[first + shardOfThisThread() * stride];
+        fenwickUp(i + 1, n, [&](int node) {
+            std::atomic_ref<T>(shard[node]).fetch_add(delta, std::memory_order_relaxed);
+        });
+    }
+    // Computes the prefix sum up to element i (clamped to the array). Safe to call from any thread.
+    T query(int i) const {
+        return prefix(std::min(i + 1, n));
+    }
+    T rangeQuery(int l, int r) const {
+        if (l > r) {
+            return 0;
+        }
+        return query(r) - query(l - 1);
+    }
+    int size() const {
+        return n;
+    }
+    int shardCount() const {
+        return shards;
+    }
+};
+
+template<typename U>
+ConcurrentFenwickTree(const std::vector<U>&, int = 1) -> ConcurrentFenwickTree<std::conditional_t<std::is_integral_v<U>, long long, U>>;
+
+// Zeroed storage from an anonymous mapping, page aligned (so every block is one cache line).
+// With hugePages, the mapping is rounded to 2 MiB and madvise'd for transparent huge pages,
+// so a walk over a large tree costs one TLB entry per 2 MiB instead of per 4 KiB.
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+class FenwickStorage {
+private:
+    static constexpr size_t HUGE_PAGE = 2 << 20;
+
+    T* base = nullptr;
+    size_t length = 0;
+public:
+    FenwickStorage() = default;
+    FenwickStorage(size_t count, bool hugePages) {
+        if (count == 0) {
+            return;
+        }
+        length = count * sizeof(T);
+        if (hugePages) {
+            length = (length + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        }
+        void* mapped = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "Cannot map Fenwick tree storage");
+        }
+        // Only a hint: without THP support the tree still works on normal pages
+        if (hugePages) {
+            ::madvise(mapped, length, MADV_HUGEPAGE);
+        }
+        base = static_cast<T*>(mapped);
+    }
+    FenwickStorage(FenwickStorage&& other) noexcept : base(std::exchange(other.base, nullptr)), length(std::exchange(other.length, 0)) {}
+    FenwickStorage& operator=(FenwickStorage&& other) noexcept {
+        std::swap(base, other.base);
+        std::swap(length, other.length);
+        return *this;
+    }
+    ~FenwickStorage() {
+        if (base) {
+            ::munmap(base, length);
+        }
+    }
+    T& operator[](size_t i) {
+        return base[i];
+    }
+    const T& operator[](size_t i) const {
+        return base[i];
+    }
+};
+
+// Fenwick tree with the same API as FenwickTree, laid out for arrays too big for the cache.
+// Elements are grouped into cache-line blocks of B values, and each block holds the prefix
+// sums within it. The block totals form the next level up, blocked the same way, until one
+// block is left. So for n = 10^9 and 8-byte values there are 10 levels instead of 30 nodes:
+// - query reads one value per level,
+// - update adds delta to the tail of one block per level, a single cache line each,
+// and the upper levels are small enough to stay in the cache.
+template<typename T = long long>
+class BlockedFenwickTree {
+private:
+    static constexpr int B = std::max<int>(1, 64 / sizeof(T));
+
+    FenwickStorage<T> data;
+    // levelStart[h] is where level h begins in data, level 0 holds the elements
+    std::vector<size_t> levelStart;
+    int n;
+
+    // Adds delta to entries from..B-1 of a block, branch-free so it vectorizes
+    static void addTail(T* block, int from, T delta) {
+        for (int j = 0; j < B; j++) {
+            block[j] += (j >= from) ? delta : T{};
+        }
+    }
+public:
+    template<typename U>
+    BlockedFenwickTree(const std::vector<U>& nums, bool hugePages = false) : n(nums.size()) {
+        size_t total = 0;
+        for (size_t count = n; count > 0; count = (count > (size_t)B) ? (count + B - 1) / B : 0) {
+            levelStart.push_back(total);
+            total += (count + B - 1) / B * B;
+        }
+        data = FenwickStorage<T>(total, hugePages);
+        // Builds in O(n): prefix sums within each block, whose last entries feed the level above
+        for (int i = 0; i < n; i++) {
+            data[i] = static_cast<T>(nums[i]);
+        }
+        for (size_t h = 0; h < levelStart.size(); h++) {
+            size_t count = (h + 1 < levelStart.size() ? levelStart[h + 1] : total) - levelStart[h];
+            T* level = &data[levelStart[h]];
+            for (size_t block = 0; block < count; block += B) {
+                for (int j = 1; j < B; j++) {
+                    level[block + j] += level[block + j - 1];
+                }
+                if (h + 1 < levelStart.size()) {
+                    data[levelStart[h + 1] + block / B] = level[block + B - 1];
+                }
+            }
+        }
+    }
+    // Updates the tree to reflect a change in the original array
+    void update(int i, T delta) {
+        if (i < 0 || i >= n) {
+            return;
+        }
+        size_t index = i;
+        for (size_t h = 0; h < levelStart.size(); h++, index /= B) {
+            addTail(&data[levelStart[h] + index / B * B], index % B, delta);
+        }
+    }
+    // Computes the prefix sum up to element i (clamped to the array)
+    T query(int i) const {
+        T sum{};
+        if (i < 0 || n == 0) {
+            return sum;
+        }
+        // count values at each level: the last one's in-block prefix, then the
+        // whole blocks before it, which are (count - 1) / B values one level up
+        for (size_t h = 0, count = std::min(i, n - 1) + 1; count > 0; h++, count = (count - 1) / B) {
+            sum += data[levelStart[h] + count - 1];
         }
         return sum;
     }
+    // Computes the sum of elements l through r
+    T rangeQuery(int l, int r) const {
+        if (l > r) {
+            return T{};
+        }
+        return query(r) - query(l - 1);
+    }
+    // Returns the first index i with query(i) >= target, or size() if there is none.
+    // Needs every element to be non-negative. Picks one entry per level from the top down.
+    int lower_bound(T target) const requires std::totally_ordered<T> {
+        if (n == 0) {
+            return 0;
+        }
+        size_t block = 0;
+        for (size_t h = levelStart.size(); h-- > 0;) {
+            const T* entries = &data[levelStart[h] + block * B];
+            int j = 0;
+            while (j < B && entries[j] < target) {
+                j++;
+            }
+            if (j == B) {
+                return n;
+            }
+            if (j > 0) {
+                target -= entries[j - 1];
+            }
+            block = block * B + j;
+        }
+        return std::min<size_t>(block, n);
+    }
+    int size() const {
+        return n;
+    }
 };
 
+template<typename U>
+BlockedFenwickTree(const std::vector<U>&, bool = false) -> BlockedFenwickTree<std::conditional_t<std::is_integral_v<U>, long long, U>>;
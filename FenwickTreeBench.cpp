@@ -0,0 +1,354 @@
+// Benchmark for FenwickTree against the previous int tree built with one update per element.
+// Usage: ./FenwickTreeBench [n] [max_side] [max_threads] [large_n]
+//   (defaults to 10000000 elements, 4096, 32 threads and 268435456 elements)
+// Compares build time of the O(n) build with n updates, then times update, query,
+// rangeQuery and lower_bound for long long, double and Modular values.
+// Then RangeFenwickTree range adds against one update per element, and FenwickTree2D
+// against a vector<vector> 2D tree on grids from 256x256 up to max_side x max_side.
+// Last, 1 to max_threads ingestion threads update a 65536-bucket histogram, querying
+// once every 64 updates: FenwickTree behind a std::mutex, ConcurrentFenwickTree, and
+// ConcurrentFenwickTree with one shard per thread.
+// Then update and query latency on a large_n array for FenwickTree and BlockedFenwickTree,
+// on normal and on transparent huge pages. Queries are also run as a dependent chain,
+// each index taken from the previous result, so the misses can not overlap.
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FenwickTree.cpp"
+
+// The original int tree, kept as the baseline
+class HandFenwickTree {
+private:
+std::vector<int> tree;
+int n;
+public:
+    HandFenwickTree(const std::vector<int>& nums) : tree(nums.size()+1), n(nums.size()) {
+        for (int i = 0; i < n; i++) {
+            update(i, nums[i]);
+        }
+    }
+    void update(int i, int delta) {
+        i++;
+        while (i <= n) {
+            tree[i] += delta;
+            i += i & -i;
+        }
+    }
+    long query(int i) {
+        i++;
+        long sum = 0;
+        while (i > 0) {
+            sum += tree[i];
+            i -= i & -i;
+        }
+        return sum;
+    }
+};
+
+// A 2D tree with one vector per row, kept as the baseline for FenwickTree2D
+class NestedFenwickTree2D {
+private:
+std::vector<std::vector<long long>> tree;
+int rows;
+int cols;
+public:
+    NestedFenwickTree2D(int rows, int cols) : tree(rows + 1, std::vector<long long>(cols + 1)), rows(rows), cols(cols) {}
+    void update(int r, int c, long long delta) {
+        for (int i = r + 1; i <= rows; i += i & -i) {
+            for (int j = c + 1; j <= cols; j += j & -j) {
+                tree[i][j] += delta;
+            }
+        }
+    }
+    long long query(int r, int c) const {
+        long long sum = 0;
+        for (int i = r + 1; i > 0; i -= i & -i) {
+            for (int j = c + 1; j > 0; j -= j & -j) {
+                sum += tree[i][j];
+            }
+        }
+        return sum;
+    }
+    long long rangeQuery(int r1, int c1, int r2, int c2) const {
+        return query(r2, c2) - query(r1 - 1, c2) - query(r2, c1 - 1) + query(r1 - 1, c1 - 1);
+    }
+};
+
+// Returns nanoseconds per operation of fn() over ops operations
+template<typename Fn>
+double timeNs(size_t ops, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+volatile long long sink;
+
+struct Op {
+    int left, right, val;
+};
+
+long long toLong(long long x) { return x; }
+long long toLong(double x) { return static_cast<long long>(x); }
+template<uint32_t MOD>
+long long toLong(Modular<MOD> x) { return x.value; }
+
+template<typename T>
+void run(const std::string& name, const std::vector<int>& nums, const std::vector<Op>& ops) {
+    std::vector<T> values(nums.begin(), nums.end());
+    FenwickTree<T>* tree = nullptr;
+    double buildNs = timeNs(nums.size(), [&] {
+        tree = new FenwickTree<T>(values);
+    });
+    double updateNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            tree->update(op.left, T(op.val));
+        }
+    });
+    double queryNs = timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (const Op& op : ops) {
+            total += toLong(tree->query(op.right));
+        }
+        sink = total;
+    });
+    double rangeNs = timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (const Op& op : ops) {
+            total += toLong(tree->rangeQuery(op.left, op.right));
+        }
+        sink = total;
+    });
+    std::string line = std::format("  {:<12} build {:5.1f} ns/elem  update {:6.1f} ns  query {:6.1f} ns  rangeQuery {:6.1f} ns",
+        name, buildNs, updateNs, queryNs, rangeNs);
+    if constexpr (std::totally_ordered<T>) {
+        // Targets spread over the whole weight, as in weighted sampling
+        T total = tree->query(tree->size() - 1);
+        double lowerBoundNs = timeNs(ops.size(), [&] {
+            long long found = 0;
+            for (const Op& op : ops) {
+                found += tree->lower_bound(total / T(1000) * T(op.val));
+            }
+            sink = found;
+        });
+        line += std::format("  lower_bound {:6.1f} ns", lowerBoundNs);
+    }
+    std::cout << line << "\n";
+    delete tree;
+}
+
+// Adds to ranges of about rangeLength elements, with RangeFenwickTree and with one update per element
+void runRangeAdd(const std::vector<int>& nums, const std::vector<Op>& ops, int rangeLength) {
+    RangeFenwickTree rangeTree(nums);
+    FenwickTree pointTree(nums);
+    int n = nums.size();
+    auto clamp = [&](const Op& op) {
+        return std::min(op.left + rangeLength - 1, n - 1);
+    };
+    double rangeNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            rangeTree.rangeAdd(op.left, clamp(op), op.val);
+        }
+    });
+    double pointNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            for (int i = op.left, right = clamp(op); i <= right; i++) {
+                pointTree.update(i, op.val);
+            }
+        }
+    });
+    double sumNs = timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (const Op& op : ops) {
+            total += rangeTree.rangeQuery(op.left, op.right);
+        }
+        sink = total;
+    });
+    std::cout << std::format("  length {:<6} rangeAdd {:7.1f} ns  per-element updates {:9.1f} ns  rangeQuery {:6.1f} ns\n",
+        rangeLength, rangeNs, pointNs, sumNs);
+}
+
+// Point updates and rectangle sums on a side x side grid
+template<typename Tree>
+void run2D(const std::string& name, int side, const std::vector<Op>& ops) {
+    Tree tree(side, side);
+    double updateNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            tree.update(op.left % side, op.right % side, op.val);
+        }
+    });
+    double queryNs = timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (const Op& op : ops) {
+            int r1 = op.left % side, r2 = op.right % side;
+            int c1 = op.val % side, c2 = (op.left + op.right) % side;
+            total += tree.rangeQuery(std::min(r1, r2), std::min(c1, c2), std::max(r1, r2), std::max(c1, c2));
+        }
+        sink = total;
+    });
+    std::cout << std::format("  {:>4}x{:<4} {:<20} update {:7.1f} ns ({:5.1f} Mops/s)  rectangle {:7.1f} ns ({:5.1f} Mops/s)\n",
+        side, side, name, updateNs, 1000 / updateNs, queryNs, 1000 / queryNs);
+}
+
+// The single lock every ingestion thread used to share
+class LockedFenwickTree {
+private:
+FenwickTree<long long> tree;
+mutable std::mutex mutex;
+public:
+    LockedFenwickTree(const std::vector<int>& nums, int) : tree(nums) {}
+    void update(int i, long long delta) {
+        std::lock_guard lock(mutex);
+        tree.update(i, delta);
+    }
+    long long query(int i) const {
+        std::lock_guard lock(mutex);
+        return tree.query(i);
+    }
+};
+
+// Each thread updates random buckets and reads one prefix sum every 64 updates.
+// shardsPerThread gives the tree one shard per thread (ignored by trees without shards).
+template<typename Tree>
+void runContention(const std::string& name, const std::vector<Op>& ops, unsigned maxThreads, bool shardsPerThread) {
+    constexpr size_t OPS_PER_THREAD = 1000000;
+    constexpr int BUCKETS = 1 << 16;
+    std::cout << std::format("  {}\n", name);
+    double baseline = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        Tree tree(std::vector<int>(BUCKETS), shardsPerThread ? threads : 1);
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                long long total = 0;
+                for (size_t i = t * 7919, end = i + OPS_PER_THREAD; i < end; i++) {
+                    const Op& op = ops[i % ops.size()];
+                    tree.update(op.left % BUCKETS, 1);
+                    if (i % 64 == 0) {
+                        total += tree.query(op.right % BUCKETS);
+                    }
+                }
+                sink = total;
+            });
+        }
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        double mops = threads * OPS_PER_THREAD / std::chrono::duration<double, std::micro>(end - start).count();
+        if (threads == 1) {
+            baseline = mops;
+        }
+        std::cout << std::format("    threads {:>2}  {:8.2f} Mops/s  speedup {:5.2f}x\n", threads, mops, mops / baseline);
+    }
+}
+
+// Random updates and queries on a large array, independent and as a dependent chain
+template<typename Tree>
+void runLarge(const std::string& name, Tree& tree, const std::vector<Op>& ops) {
+    int n = tree.size();
+    double updateNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            tree.update(op.right % n, op.val);
+        }
+    });
+    double queryNs = timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (const Op& op : ops) {
+            total += tree.query(op.right % n);
+        }
+        sink = total;
+    });
+    double chainNs = timeNs(ops.size(), [&] {
+        long long previous = 0;
+        for (const Op& op : ops) {
+            previous = tree.query((op.right + previous) % n);
+        }
+        sink = previous;
+    });
+    std::cout << std::format("  {:<32} update {:7.1f} ns  query {:7.1f} ns  dependent query {:7.1f} ns\n",
+        name, updateNs, queryNs, chainNs);
+}
+
+int main(int argc, char** argv) {
+    int n = (argc > 1) ? std::stoi(argv[1]) : 10000000;
+    int maxSide = (argc > 2) ? std::stoi(argv[2]) : 4096;
+    unsigned maxThreads = (argc > 3) ? std::stoul(argv[3]) : 32;
+    int largeN = (argc > 4) ? std::stoi(argv[4]) : 1 << 28;
+    std::mt19937 rng(42);
+    std::vector<int> nums(n);
+    for (int& x : nums) {
+        x = rng() % 1000;
+    }
+    std::vector<Op> ops(1000000);
+    for (Op& op : ops) {
+        op.left = rng() % n;
+        op.right = rng() % n;
+        if (op.left > op.right) {
+            std::swap(op.left, op.right);
+        }
+        op.val = rng() % 1000;
+    }
+    std::cout << "Build, n=" << n << "\n";
+    HandFenwickTree* hand = nullptr;
+    double handNs = timeNs(nums.size(), [&] {
+        hand = new HandFenwickTree(nums);
+    });
+    sink = hand->query(n - 1);
+    delete hand;
+    double linearNs = timeNs(nums.size(), [&] {
+        FenwickTree ft(nums);
+        sink = ft.query(n - 1);
+    });
+    std::cout << std::format("  n updates (int) {:5.1f} ns/elem  O(n) build (long long) {:5.1f} ns/elem\n", handNs, linearNs);
+    std::cout << "Operations, " << ops.size() << " ops\n";
+    run<long long>("long long", nums, ops);
+    run<double>("double", nums, ops);
+    run<Modular<1000000007>>("Modular", nums, ops);
+    std::vector<Op> few(ops.begin(), ops.begin() + 10000);
+    std::cout << "Range add, " << few.size() << " ops\n";
+    for (int length : {1, 16, 1024}) {
+        runRangeAdd(nums, few, std::min(length, n));
+    }
+    std::cout << "2D point update and rectangle sum, " << ops.size() << " ops\n";
+    for (int side = 256; side <= maxSide; side *= 4) {
+        run2D<FenwickTree2D<long long>>("FenwickTree2D", side, ops);
+        run2D<NestedFenwickTree2D>("vector<vector>", side, ops);
+    }
+    std::cout << "Histogram updates from many threads\n";
+    runContention<LockedFenwickTree>("FenwickTree + std::mutex", ops, maxThreads, false);
+    runContention<ConcurrentFenwickTree<long long>>("ConcurrentFenwickTree", ops, maxThreads, false);
+    runContention<ConcurrentFenwickTree<long long>>("ConcurrentFenwickTree, shard per thread", ops, maxThreads, true);
+    std::cout << "Large array, n=" << largeN << ", " << ops.size() << " ops\n";
+    std::vector<int> large(largeN);
+    for (int& x : large) {
+        x = rng() % 1000;
+    }
+    std::vector<Op> largeOps(ops.size());
+    for (Op& op : largeOps) {
+        op.right = rng() % largeN;
+        op.val = rng() % 1000;
+    }
+    {
+        FenwickTree tree(large);
+        runLarge("FenwickTree", tree, largeOps);
+    }
+    {
+        BlockedFenwickTree tree(large);
+        runLarge("BlockedFenwickTree", tree, largeOps);
+    }
+    {
+        BlockedFenwickTree tree(large, true);
+        runLarge("BlockedFenwickTree, huge pages", tree, largeOps);
+    }
+    return 0;
+}
@@ -1,6 +1,10 @@
 #include <vector>
 #include <iostream>
 #include <cassert>
+#include <climits>
+#include <cmath>
+#include <random>
+#include <thread>
 
 #include "FenwickTree.cpp"
 // Assuming FenwickTree class is defined as above
@@ -131,6 +135,321 @@ void test_negative_numbers() {
     std::cout << "test_negative_numbers passed.\n";
 }
 
+void test_linear_build_matches_updates() {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> value(-1000, 1000);
+    for (int n : {1, 2, 3, 7, 8, 9, 100, 1023, 1024, 1025}) {
+        std::vector<int> nums(n);
+        for (int& x : nums) {
+            x = value(rng);
+        }
+        FenwickTree built(nums);
+        FenwickTree updated(std::vector<int>(n, 0));
+        for (int i = 0; i < n; i++) {
+            updated.update(i, nums[i]);
+        }
+        long long prefix = 0;
+        for (int i = 0; i < n; i++) {
+            prefix += nums[i];
+            assert(built.query(i) == prefix);
+            assert(updated.query(i) == prefix);
+        }
+    }
+    std::cout << "test_linear_build_matches_updates passed.\n";
+}
+
+void test_large_counters_do_not_overflow() {
+    std::vector<int> nums(4, INT_MAX);
+    FenwickTree ft(nums);
+    static_assert(std::is_same_v<decltype(ft.query(0)), long long>);
+    assert(ft.query(3) == 4LL * INT_MAX);
+    ft.update(0, INT_MAX);
+    assert(ft.query(3) == 5LL * INT_MAX);
+    std::cout << "test_large_counters_do_not_overflow passed.\n";
+}
+
+void test_range_query() {
+    std::vector<int> nums = {3, -1, 4, 1, -5, 9, 2, 6};
+    FenwickTree ft(nums);
+    for (int l = 0; l < (int)nums.size(); l++) {
+        long long expected = 0;
+        for (int r = l; r < (int)nums.size(); r++) {
+            expected += nums[r];
+            assert(ft.rangeQuery(l, r) == expected);
+        }
+    }
+    assert(ft.rangeQuery(5, 4) == 0);
+    ft.update(4, 5); // [3,-1,4,1,0,9,2,6]
+    assert(ft.rangeQuery(3, 5) == 10);
+    std::cout << "test_range_query passed.\n";
+}
+
+void test_lower_bound() {
+    std::vector<int> weights = {2, 0, 3, 1, 0, 4};
+    FenwickTree ft(weights);
+    // Prefix sums are 2, 2, 5, 6, 6, 10
+    assert(ft.lower_bound(0) == 0);
+    assert(ft.lower_bound(1) == 0);
+    assert(ft.lower_bound(2) == 0);
+    assert(ft.lower_bound(3) == 2);
+    assert(ft.lower_bound(5) == 2);
+    assert(ft.lower_bound(6) == 3);
+    assert(ft.lower_bound(7) == 5);
+    assert(ft.lower_bound(10) == 5);
+    assert(ft.lower_bound(11) == 6);  // Past the total weight
+
+    // Order statistics: counts of each value, find the k-th smallest
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> count(0, 3);
+    std::vector<int> counts(300);
+    for (int& c : counts) {
+        c = count(rng);
+    }
+    FenwickTree order(counts);
+    int k = 1;
+    for (int v = 0; v < (int)counts.size(); v++) {
+        for (int j = 0; j < counts[v]; j++, k++) {
+            assert(order.lower_bound(k) == v);
+        }
+    }
+    assert(order.lower_bound(k) == (int)counts.size());
+
+    FenwickTree empty(std::vector<int>{});
+    assert(empty.lower_bound(1) == 0);
+    std::cout << "test_lower_bound passed.\n";
+}
+
+void test_double_values() {
+    std::vector<double> probs = {0.1, 0.2, 0.3, 0.4};
+    FenwickTree ft(probs);
+    static_assert(std::is_same_v<decltype(ft.query(0)), double>);
+    assert(std::abs(ft.query(3) - 1.0) < 1e-12);
+    assert(std::abs(ft.rangeQuery(1, 2) - 0.5) < 1e-12);
+    assert(ft.lower_bound(0.35) == 2);
+    ft.update(0, 0.5);
+    assert(ft.lower_bound(0.55) == 0);
+    std::cout << "test_double_values passed.\n";
+}
+
+void test_modular_values() {
+    using Mod = Modular<1000000007>;
+    std::vector<long long> nums = {1000000006, 5, 1000000000000LL, -3};
+    FenwickTree<Mod> ft(nums);
+    assert(ft.query(1) == Mod(4));
+    assert(ft.query(3) == Mod(1000000006LL + 5 + 1000000000000LL - 3));
+    assert(ft.rangeQuery(1, 2) == Mod(5 + 1000000000000LL));
+    ft.update(3, Mod(3));
+    assert(ft.rangeQuery(3, 3) == Mod(0));
+    std::cout << "test_modular_values passed.\n";
+}
+
+void test_range_add_range_sum() {
+    std::mt19937 rng(13);
+    for (int n : {1, 2, 5, 64, 100}) {
+        std::vector<long long> model(n);
+        for (long long& x : model) {
+            x = (int)(rng() % 201) - 100;
+        }
+        RangeFenwickTree ft(model);
+        for (int step = 0; step < 500; step++) {
+            int l = rng() % n;
+            int r = rng() % n;
+            if (l > r) {
+                std::swap(l, r);
+            }
+            if (step % 2 == 0) {
+                long long delta = (int)(rng() % 201) - 100;
+                ft.rangeAdd(l, r, delta);
+                for (int i = l; i <= r; i++) {
+                    model[i] += delta;
+                }
+            } else {
+                long long expected = 0;
+                for (int i = l; i <= r; i++) {
+                    expected += model[i];
+                }
+                assert(ft.rangeQuery(l, r) == expected);
+            }
+        }
+        long long prefix = 0;
+        for (int i = 0; i < n; i++) {
+            prefix += model[i];
+            assert(ft.query(i) == prefix);
+        }
+    }
+
+    RangeFenwickTree<long long> zeros(5);
+    zeros.rangeAdd(1, 3, 2);   // [0,2,2,2,0]
+    zeros.update(4, 7);        // [0,2,2,2,7]
+    assert(zeros.rangeQuery(0, 4) == 13);
+    assert(zeros.rangeQuery(2, 2) == 2);
+    zeros.rangeAdd(3, 2, 100); // Empty range
+    assert(zeros.query(4) == 13);
+    std::cout << "test_range_add_range_sum passed.\n";
+}
+
+void test_2d_rectangle_sums() {
+    std::mt19937 rng(17);
+    const int rows = 13;
+    const int cols = 21;
+    std::vector<std::vector<int>> grid(rows, std::vector<int>(cols));
+    for (auto& row : grid) {
+        for (int& x : row) {
+            x = (int)(rng() % 21) - 10;
+        }
+    }
+    FenwickTree2D ft(grid);
+    FenwickTree2D<long long> updated(rows, cols);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            updated.update(r, c, grid[r][c]);
+        }
+    }
+    auto bruteForce = [&](int r1, int c1, int r2, int c2) {
+        long long sum = 0;
+        for (int r = r1; r <= r2; r++) {
+            for (int c = c1; c <= c2; c++) {
+                sum += grid[r][c];
+            }
+        }
+        return sum;
+    };
+    for (int step = 0; step < 1000; step++) {
+        int r1 = rng() % rows, r2 = rng() % rows;
+        int c1 = rng() % cols, c2 = rng() % cols;
+        if (r1 > r2) {
+            std::swap(r1, r2);
+        }
+        if (c1 > c2) {
+            std::swap(c1, c2);
+        }
+        if (step % 3 == 0) {
+            int delta = (int)(rng() % 21) - 10;
+            grid[r1][c1] += delta;
+            ft.update(r1, c1, delta);
+            updated.update(r1, c1, delta);
+        }
+        long long expected = bruteForce(r1, c1, r2, c2);
+        assert(ft.rangeQuery(r1, c1, r2, c2) == expected);
+        assert(updated.rangeQuery(r1, c1, r2, c2) == expected);
+    }
+    assert(ft.query(rows - 1, cols - 1) == bruteForce(0, 0, rows - 1, cols - 1));
+    assert(ft.rangeQuery(3, 3, 2, 5) == 0);
+
+    FenwickTree2D empty(std::vector<std::vector<int>>{});
+    assert(empty.query(0, 0) == 0);
+    bool threw = false;
+    try {
+        FenwickTree2D ragged(std::vector<std::vector<int>>{{1, 2}, {3}});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_2d_rectangle_sums passed.\n";
+}
+
+void test_concurrent_counters() {
+    const int n = 1000;
+    const int writers = 4;
+    const int perWriter = 20000;
+    for (int shards : {1, 4}) {
+        std::vector<int> initial(n, 1);
+        ConcurrentFenwickTree ft(initial, shards);
+        assert(ft.shardCount() == shards);
+        std::atomic<bool> done = false;
+        std::thread reader([&] {
+            // Deltas are all positive, so every prefix this thread reads only grows
+            long long lastTotal = 0;
+            long long lastHalf = 0;
+            while (!done.load()) {
+                long long total = ft.query(n - 1);
+                long long half = ft.query(n / 2);
+                assert(total >= lastTotal && total >= n);
+                assert(half >= lastHalf && half >= n / 2 + 1);
+                lastTotal = total;
+                lastHalf = half;
+            }
+        });
+        std::vector<std::thread> threads;
+        for (int t = 0; t < writers; t++) {
+            threads.emplace_back([&ft, t] {
+                std::mt19937 rng(t);
+                for (int k = 0; k < perWriter; k++) {
+                    ft.update(rng() % n, 1 + t);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        done = true;
+        reader.join();
+
+        std::vector<long long> expected(n, 1);
+        for (int t = 0; t < writers; t++) {
+            std::mt19937 rng(t);
+            for (int k = 0; k < perWriter; k++) {
+                expected[rng() % n] += 1 + t;
+            }
+        }
+        long long prefix = 0;
+        for (int i = 0; i < n; i++) {
+            prefix += expected[i];
+            assert(ft.query(i) == prefix);
+            assert(ft.rangeQuery(i, i) == expected[i]);
+        }
+    }
+    ConcurrentFenwickTree empty(std::vector<int>{}, 3);
+    assert(empty.query(0) == 0);
+    std::cout << "test_concurrent_counters passed.\n";
+}
+
+void test_blocked_matches_classic() {
+    std::mt19937 rng(19);
+    for (int n : {0, 1, 7, 8, 9, 63, 64, 65, 512, 513, 5000}) {
+        std::vector<int> nums(n);
+        for (int& x : nums) {
+            x = rng() % 10;
+        }
+        BlockedFenwickTree blocked(nums, n == 5000);
+        FenwickTree classic(nums);
+        assert(blocked.size() == n);
+        for (int step = 0; step < 2000 && n > 0; step++) {
+            int i = rng() % n;
+            int j = rng() % n;
+            switch (step % 4) {
+            case 0: {
+                int delta = rng() % 10;
+                blocked.update(i, delta);
+                classic.update(i, delta);
+                break;
+            }
+            case 1:
+                assert(blocked.query(i) == classic.query(i));
+                break;
+            case 2:
+                assert(blocked.rangeQuery(std::min(i, j), std::max(i, j)) == classic.rangeQuery(std::min(i, j), std::max(i, j)));
+                break;
+            default: {
+                long long target = rng() % (classic.query(n - 1) + 2);
+                assert(blocked.lower_bound(target) == classic.lower_bound(target));
+                break;
+            }
+            }
+        }
+        for (int i = -1; i <= n; i++) {
+            assert(blocked.query(i) == classic.query(i));
+        }
+        long long total = classic.query(n - 1);
+        assert(blocked.lower_bound(total + 1) == n);
+    }
+
+    BlockedFenwickTree<double> probs(std::vector<double>{0.25, 0.25, 0.5});
+    assert(probs.lower_bound(0.6) == 2);
+    assert(std::abs(probs.rangeQuery(1, 2) - 0.75) < 1e-12);
+    std::cout << "test_blocked_matches_classic passed.\n";
+}
+
 int main() {
     test_initialization_and_basic_queries();
     test_single_element_updates();
@@ -139,6 +458,16 @@ int main() {
     test_single_element_array();
     test_all_zeroes();
     test_negative_numbers();
+    test_linear_build_matches_updates();
+    test_large_counters_do_not_overflow();
+    test_range_query();
+    test_lower_bound();
+    test_double_values();
+    test_modular_values();
+    test_range_add_range_sum();
+    test_2d_rectangle_sums();
+    test_concurrent_counters();
+    test_blocked_matches_classic();
     
     std::cout << "All tests passed successfully.\n";
     return 0;
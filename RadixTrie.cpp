@@ -0,0 +1,356 @@
+/*
+Path-compressed (radix) trie over arbitrary bytes.
+Drop-in replacement for Trie: same insert/search/startsWith, but any byte may
+appear in a key (URLs, UTF-8 identifiers, ...) and chains of single-child
+nodes collapse into one edge with a multi-byte label.
+
+Layout:
+- nodes: 16 byte records addressed by uint32_t index (root is 0, with an empty label).
+  The label of the edge into a node is stored in the record itself when it is at most
+  INLINE_LABEL bytes, otherwise it is labels[labelOffset, labelOffset + labelLength).
+- the children of a node are contiguous at nodes[firstChild, firstChild + numChildren),
+  sorted by the first byte of their label.
+- firstBytes[i] is the first label byte of node i, so picking a child scans one
+  small byte range instead of touching every sibling record.
+- a static build from sorted keys lays the nodes out breadth-first with no gaps.
+  Later inserts move a node's child block to a block one larger, removes to a block one
+  smaller, and freed blocks are reused through a free list per block size.
+- every node but the root either ends a word or has at least two children. remove()
+  keeps this by merging a node into its only child; the merged label is appended to
+  labels when it is long, and the old label bytes are not reclaimed.
+*/
+#include <vector>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+class RadixTrie {
+private:
+    static constexpr uint32_t INLINE_LABEL = 4;
+    struct Node {
+        union {
+            uint32_t labelOffset;
+            char inlineLabel[INLINE_LABEL];
+        };
+        uint32_t labelLength;
+        uint32_t firstChild;
+        uint16_t numChildren;
+        bool isEnd;
+    };
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr size_t MAX_CHILDREN = 256;
+
+    std::vector<Node> nodes;
+    std::vector<unsigned char> firstBytes;
+    std::vector<unsigned char> labels;
+    // freeBlocks[k] heads a list of released child blocks of k nodes,
+    // linked through the firstChild field of their first node
+    std::array<uint32_t, MAX_CHILDREN + 1> freeBlocks;
+
+    // The view points into n for short labels, so n must outlive it
+    std::string_view label(const Node& n) const {
+        if (n.labelLength <= INLINE_LABEL) {
+            return {n.inlineLabel, n.labelLength};
+        }
+        return {reinterpret_cast<const char*>(labels.data()) + n.labelOffset, n.labelLength};
+    }
+    // Sets the label of n to len bytes at src. Long labels must already be in labels at offset.
+    static void setLabel(Node& n, const char* src, uint32_t len, uint32_t offset) {
+        n.labelLength = len;
+        if (len <= INLINE_LABEL) {
+            std::copy(src, src + len, n.inlineLabel);
+        } else {
+            n.labelOffset = offset;
+        }
+    }
+    // Returns a childless node whose label is a copy of bytes
+    Node makeNode(std::string_view bytes, bool isEnd) {
+        Node n{};
+        n.isEnd = isEnd;
+        uint32_t offset = static_cast<uint32_t>(labels.size());
+        if (bytes.size() > INLINE_LABEL) {
+            labels.insert(labels.end(), bytes.begin(), bytes.end());
+        }
+        setLabel(n, bytes.data(), static_cast<uint32_t>(bytes.size()), offset);
+        return n;
+    }
+    // Returns the child of node whose label starts with b, or NONE
+    uint32_t findChild(uint32_t node, unsigned char b) const {
+        const Node& n = nodes[node];
+        const unsigned char* begin = firstBytes.data() + n.firstChild;
+        const unsigned char* end = begin + n.numChildren;
+        const unsigned char* it = begin;
+        // Most nodes have a handful of children, where a scan beats a binary search
+        if (n.numChildren <= 16) {
+            while (it != end && *it < b) {
+                it++;
+            }
+        } else {
+            it = std::lower_bound(begin, end, b);
+        }
+        if (it == end || *it != b) {
+            return NONE;
+        }
+        return static_cast<uint32_t>(it - firstBytes.data());
+    }
+    uint32_t allocBlock(uint32_t size) {
+        uint32_t block = freeBlocks[size];
+        if (block != NONE) {
+            freeBlocks[size] = nodes[block].firstChild;
+            return block;
+        }
+        block = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + size);
+        firstBytes.resize(nodes.size());
+        return block;
+    }
+    void freeBlock(uint32_t block, uint32_t size) {
+        if (size == 0) {
+            return;
+        }
+        nodes[block].firstChild = freeBlocks[size];
+        freeBlocks[size] = block;
+    }
+    // Adds child as a new child of node, keeping the block sorted by first byte
+    void addChild(uint32_t node, const Node& child, unsigned char first) {
+        uint32_t count = nodes[node].numChildren;
+        uint32_t oldBlock = nodes[node].firstChild;
+        uint32_t newBlock = allocBlock(count + 1);
+        uint32_t rank = 0;
+        while (rank < count && firstBytes[oldBlock + rank] < first) {
+            rank++;
+        }
+        for (uint32_t i = 0, j = 0; i <= count; i++) {
+            if (i == rank) {
+                nodes[newBlock + i] = child;
+                firstBytes[newBlock + i] = first;
+            } else {
+                nodes[newBlock + i] = nodes[oldBlock + j];
+                firstBytes[newBlock + i] = firstBytes[oldBlock + j];
+                j++;
+            }
+        }
+        freeBlock(oldBlock, count);
+        nodes[node].firstChild = newBlock;
+        nodes[node].numChildren = static_cast<uint16_t>(count + 1);
+    }
+    // Removes the child at index child of node's block
+    void removeChild(uint32_t node, uint32_t child) {
+        uint32_t count = nodes[node].numChildren;
+        uint32_t oldBlock = nodes[node].firstChild;
+        uint32_t newBlock = (count > 1) ? allocBlock(count - 1) : 0;
+        for (uint32_t i = 0, j = 0; i < count; i++) {
+            if (oldBlock + i != child) {
+                nodes[newBlock + j] = nodes[oldBlock + i];
+                firstBytes[newBlock + j] = firstBytes[oldBlock + i];
+                j++;
+            }
+        }
+        freeBlock(oldBlock, count);
+        nodes[node].firstChild = newBlock;
+        nodes[node].numChildren = static_cast<uint16_t>(count - 1);
+    }
+    // Joins node (not the root) with its only child. The result keeps node's place in its
+    // parent's block, so its first label byte does not change.
+    void mergeWithChild(uint32_t node) {
+        uint32_t child = nodes[node].firstChild;
+        std::string joined(label(nodes[node]));
+        joined += label(nodes[child]);
+        Node merged = nodes[child];
+        uint32_t offset = static_cast<uint32_t>(labels.size());
+        if (joined.size() > INLINE_LABEL) {
+            labels.insert(labels.end(), joined.begin(), joined.end());
+        }
+        setLabel(merged, joined.data(), static_cast<uint32_t>(joined.size()), offset);
+        nodes[node] = merged;
+        freeBlock(child, 1);
+    }
+    // Cuts the label of node after `at` bytes. The node keeps its place in its parent's
+    // block and becomes the upper half; everything below moves into a new single child.
+    void split(uint32_t node, uint32_t at) {
+        Node original = nodes[node];
+        uint32_t offset = original.labelOffset;
+        const char* bytes = label(original).data();
+        Node lower = original;
+        setLabel(lower, bytes + at, original.labelLength - at, offset + at);
+        Node upper = original;
+        setLabel(upper, bytes, at, offset);
+        uint32_t block = allocBlock(1);
+        nodes[block] = lower;
+        firstBytes[block] = static_cast<unsigned char>(bytes[at]);
+        upper.firstChild = block;
+        upper.numChildren = 1;
+        upper.isEnd = false;
+        nodes[node] = upper;
+    }
+    // Follows key from the root. Returns the last node reached and how many bytes of
+    // key were consumed, including a partial match into that node's label.
+    // matched == key.size() with a partial label means key ends inside an edge.
+    std::pair<uint32_t, size_t> walk(std::string_view key, bool& endsOnNode) const {
+        uint32_t curr = 0;
+        size_t i = 0;
+        endsOnNode = true;
+        while (i < key.size()) {
+            uint32_t child = findChild(curr, static_cast<unsigned char>(key[i]));
+            if (child == NONE) {
+                return {curr, i};
+            }
+            std::string_view l = label(nodes[child]);
+            size_t n = std::min(l.size(), key.size() - i);
+            if (l.compare(0, n, key.substr(i, n)) != 0) {
+                return {curr, i};
+            }
+            curr = child;
+            i += n;
+            endsOnNode = (n == l.size());
+        }
+        return {curr, i};
+    }
+public:
+    RadixTrie() : nodes(1, Node{}), firstBytes(1, 0) {
+        freeBlocks.fill(NONE);
+    }
+    // Builds the trie from keys sorted in byte order (duplicates allowed) in
+    // time linear in their total length. Children blocks are laid out breadth-first.
+    explicit RadixTrie(const std::vector<std::string>& sortedKeys) : RadixTrie() {
+        for (size_t i = 1; i < sortedKeys.size(); i++) {
+            if (sortedKeys[i] < sortedKeys[i - 1]) {
+                throw std::invalid_argument("Keys must be sorted");
+            }
+        }
+        // Every key in [lo, hi) starts with the path to node, which is depth bytes long
+        struct Range {
+            uint32_t node;
+            size_t lo, hi, depth;
+        };
+        std::vector<Range> queue = {{0, 0, sortedKeys.size(), 0}};
+        for (size_t q = 0; q < queue.size(); q++) {
+            auto [node, lo, hi, depth] = queue[q];
+            // Keys equal to the path sort first
+            while (lo < hi && sortedKeys[lo].size() == depth) {
+                nodes[node].isEnd = true;
+                lo++;
+            }
+            // Count the distinct next bytes to size the child block
+            uint32_t count = 0;
+            for (size_t i = lo; i < hi; i++) {
+                if (i == lo || sortedKeys[i][depth] != sortedKeys[i - 1][depth]) {
+                    count++;
+                }
+            }
+            if (count == 0) {
+                continue;
+            }
+            uint32_t block = static_cast<uint32_t>(nodes.size());
+            nodes.resize(nodes.size() + count);
+            firstBytes.resize(nodes.size());
+            nodes[node].firstChild = block;
+            nodes[node].numChildren = static_cast<uint16_t>(count);
+            size_t start = lo;
+            for (uint32_t c = 0; c < count; c++) {
+                size_t end = start + 1;
+                while (end < hi && sortedKeys[end][depth] == sortedKeys[start][depth]) {
+                    end++;
+                }
+                // In sorted order the group's common prefix is that of its first and last key
+                const std::string& a = sortedKeys[start];
+                const std::string& b = sortedKeys[end - 1];
+                size_t lcp = depth + 1;
+                while (lcp < a.size() && lcp < b.size() && a[lcp] == b[lcp]) {
+                    lcp++;
+                }
+                std::string_view l = std::string_view(a).substr(depth, lcp - depth);
+                nodes[block + c] = makeNode(l, false);
+                firstBytes[block + c] = static_cast<unsigned char>(l[0]);
+                queue.push_back({block + c, start, end, lcp});
+                start = end;
+            }
+        }
+    }
+    void insert(std::string_view word) {
+        uint32_t curr = 0;
+        size_t i = 0;
+        while (i < word.size()) {
+            unsigned char b = static_cast<unsigned char>(word[i]);
+            uint32_t child = findChild(curr, b);
+            if (child == NONE) {
+                std::string_view rest = word.substr(i);
+                addChild(curr, makeNode(rest, true), b);
+                return;
+            }
+            std::string_view l = label(nodes[child]);
+            size_t m = 0;
+            while (m < l.size() && i + m < word.size() && l[m] == word[i + m]) {
+                m++;
+            }
+            if (m < l.size()) {
+                split(child, static_cast<uint32_t>(m));
+            }
+            curr = child;
+            i += m;
+        }
+        nodes[curr].isEnd = true;
+    }
+    // Removes word. Returns false if it was not present.
+    bool remove(std::string_view word) {
+        // parent and node end up as the last two nodes on the path of word
+        uint32_t parent = NONE;
+        uint32_t node = 0;
+        size_t i = 0;
+        while (i < word.size()) {
+            uint32_t child = findChild(node, static_cast<unsigned char>(word[i]));
+            if (child == NONE) {
+                return false;
+            }
+            std::string_view l = label(nodes[child]);
+            if (word.size() - i < l.size() || l != word.substr(i, l.size())) {
+                return false;
+            }
+            parent = node;
+            node = child;
+            i += l.size();
+        }
+        if (!nodes[node].isEnd) {
+            return false;
+        }
+        nodes[node].isEnd = false;
+        if (node == 0) {
+            return true;
+        }
+        if (nodes[node].numChildren == 1) {
+            mergeWithChild(node);
+        } else if (nodes[node].numChildren == 0) {
+            removeChild(parent, node);
+            if (parent != 0 && !nodes[parent].isEnd && nodes[parent].numChildren == 1) {
+                mergeWithChild(parent);
+            }
+        }
+        return true;
+    }
+    bool search(std::string_view word) const {
+        bool endsOnNode;
+        auto [node, matched] = walk(word, endsOnNode);
+        return matched == word.size() && endsOnNode && nodes[node].isEnd;
+    }
+    bool startsWith(std::string_view prefix) const {
+        bool endsOnNode;
+        auto [node, matched] = walk(prefix, endsOnNode);
+        if (matched != prefix.size()) {
+            return false;
+        }
+        // Every node but the root lies on the path of some word
+        return node != 0 || nodes[0].isEnd || nodes[0].numChildren > 0;
+    }
+    size_t nodeCount() const {
+        return nodes.size();
+    }
+    // Bytes held by the node, first-byte and label arrays, including spare capacity
+    size_t memoryUsage() const {
+        return nodes.capacity() * sizeof(Node) + firstBytes.capacity() + labels.capacity();
+    }
+};
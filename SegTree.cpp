@@ -1,75 +1,860 @@
+/*
+Segment tree over any monoid, with optional lazy range updates.
+
+SegTree<Monoid, Lazy>:
+- Monoid supplies value_type, identity() and an associative combine(a, b).
+  Sum, Min, Max and Gcd are below; a custom struct only needs the same three members.
+- Lazy is a range action. NoLazy (the default) gives point updates only.
+  RangeAdd and RangeAssign add or set every element of a range in O(lg n):
+  a node covering the whole range takes a pending tag instead of visiting its leaves.
+- everything is static member calls on template parameters, so combine and apply
+  inline exactly like the hand-written int tree they replace.
+- SegTree st(nums) on a std::vector<int> still gives the int sum tree.
+
+Layout (bottom-up, no recursion):
+- node 1 is the root, the children of node i are 2i and 2i+1, and element i is node leaves + i.
+- without Lazy, leaves is n and the tree takes exactly 2n values. A query climbs from both
+  ends of the range at once and combines at most two nodes per level.
+- with Lazy, leaves is n rounded up to a power of two, so every node covers an aligned range.
+  Pending tags sit in lazy[1...leaves), and queries apply the tags of the nodes they climb
+  through instead of pushing them, so they stay const.
+
+WideSegTree<Monoid, B>: the same queries and point updates over a B-ary tree
+whose nodes are single cache lines, for arrays too big for the cache. See below.
+- with AVX2, a block of an int or long long Sum tree is summed as two masked vectors,
+  so a range inside one block is a single vector reduction.
+- queryBatch/updateBatch walk the levels once for a whole batch.
+
+PersistentSegTree<Monoid>: every update makes a new version by copying the O(lg n)
+nodes on one root-to-leaf path and sharing the rest, so any old version stays queryable.
+Nodes live in one pooled array with reference counts, and release(version) frees the
+nodes no remaining version shares.
+
+Parallel build: SegTree(nums, threads) and ConcurrentSegTree(nums, threads) fill the leaves
+and then each level of internal nodes split into one contiguous chunk per thread. A chunk's
+children are the chunk the same thread wrote on the level below, so the threads mostly work
+on their own subtrees. The tree storage is left uninitialized until the build touches it.
+
+ConcurrentSegTree<Monoid>: a bottom-up tree where readers query without locks while
+writers update under a seqlock. See below.
+*/
 #include <vector>
 #include <algorithm>
+#include <bit>
 #include <iostream>
+#include <atomic>
+#include <barrier>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+template<typename M>
+concept SegMonoid = requires(const typename M::value_type& a) {
+    { M::identity() } -> std::convertible_to<typename M::value_type>;
+    { M::combine(a, a) } -> std::convertible_to<typename M::value_type>;
+};
+
+// An action maps every element of a range through one tag. apply must give the
+// combined value of length elements that combined to value before the tag.
+// compose(newer, older) is the tag equal to applying older and then newer.
+template<typename L, typename M>
+concept SegAction = requires(const typename L::tag_type& t, const typename M::value_type& v, size_t length) {
+    { L::identity() } -> std::convertible_to<typename L::tag_type>;
+    { L::apply(t, v, length) } -> std::convertible_to<typename M::value_type>;
+    { L::compose(t, t) } -> std::convertible_to<typename L::tag_type>;
+};
+
+template<typename T>
+struct Sum {
+    using value_type = T;
+    static T identity() { return T{}; }
+    static T combine(const T& a, const T& b) { return a + b; }
+    // combine of n copies of x
+    static T repeat(const T& x, size_t n) { return x * static_cast<T>(n); }
+};
+
+template<typename T>
+struct Min {
+    using value_type = T;
+    static T identity() { return std::numeric_limits<T>::max(); }
+    static T combine(const T& a, const T& b) { return std::min(a, b); }
+    static T repeat(const T& x, size_t) { return x; }
+};
+
+template<typename T>
+struct Max {
+    using value_type = T;
+    static T identity() { return std::numeric_limits<T>::lowest(); }
+    static T combine(const T& a, const T& b) { return std::max(a, b); }
+    static T repeat(const T& x, size_t) { return x; }
+};
 
+template<typename T>
+struct Gcd {
+    using value_type = T;
+    static T identity() { return T{}; }
+    static T combine(const T& a, const T& b) { return std::gcd(a, b); }
+    static T repeat(const T& x, size_t) { return x; }
+};
+
+template<typename Monoid>
+struct NoLazy {
+    struct tag_type {};
+    using T = typename Monoid::value_type;
+    static tag_type identity() { return {}; }
+    static T apply(const tag_type&, const T& value, size_t) { return value; }
+    static tag_type compose(const tag_type&, const tag_type&) { return {}; }
+};
+
+// Adds the tag to every element. Needs + to distribute over combine: Sum, Min, Max.
+template<typename Monoid>
+struct RangeAdd {
+    using T = typename Monoid::value_type;
+    using tag_type = T;
+    static tag_type identity() { return T{}; }
+    static T apply(const tag_type& add, const T& value, size_t length) {
+        return value + Monoid::repeat(add, length);
+    }
+    static tag_type compose(const tag_type& newer, const tag_type& older) { return newer + older; }
+};
+
+// Sets every element to the tag. Works for any monoid with repeat.
+template<typename Monoid>
+struct RangeAssign {
+    using T = typename Monoid::value_type;
+    using tag_type = std::optional<T>;
+    static tag_type identity() { return std::nullopt; }
+    static T apply(const tag_type& assign, const T& value, size_t length) {
+        return assign ? Monoid::repeat(*assign, length) : value;
+    }
+    static tag_type compose(const tag_type& newer, const tag_type& older) { return newer ? newer : older; }
+};
+
+// Default-initializes instead of value-initializing, so resizing a vector of ints leaves
+// the memory untouched and the (parallel) build is the first to write it
+template<typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template<typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+    DefaultInitAllocator() = default;
+    template<typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+    template<typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+// Trees below this many leaves are built on the calling thread
+constexpr size_t PARALLEL_BUILD_MIN = 1 << 16;
+
+// Builds a bottom-up tree with `leaves` leaves: fill(i) writes leaf i, then pull(node)
+// combines the children of every internal node, children before parents. Levels are
+// [ceil(hi / 2), hi) for hi = leaves, then each level's start, and the threads split
+// each level, meeting at a barrier in between. The top few levels run on one thread.
+template<typename Fill, typename Pull>
+void buildBottomUp(size_t leaves, unsigned threads, Fill fill, Pull pull) {
+    if (threads <= 1 || leaves < PARALLEL_BUILD_MIN) {
+        for (size_t i = 0; i < leaves; i++) {
+            fill(i);
+        }
+        for (size_t node = leaves; node-- > 1;) {
+            pull(node);
+        }
+        return;
+    }
+    constexpr size_t SERIAL_TOP = 4096;
+    std::barrier sync(threads);
+    auto work = [&](unsigned t) {
+        auto chunk = [&](size_t lo, size_t hi) {
+            return std::pair(lo + (hi - lo) * t / threads, lo + (hi - lo) * (t + 1) / threads);
+        };
+        auto [first, last] = chunk(0, leaves);
+        for (size_t i = first; i < last; i++) {
+            fill(i);
+        }
+        sync.arrive_and_wait();
+        for (size_t hi = leaves; hi > SERIAL_TOP; hi = (hi + 1) / 2) {
+            auto [lo, end] = chunk((hi + 1) / 2, hi);
+            for (size_t node = lo; node < end; node++) {
+                pull(node);
+            }
+            sync.arrive_and_wait();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    size_t top = leaves;
+    while (top > SERIAL_TOP) {
+        top = (top + 1) / 2;
+    }
+    for (size_t node = top - 1; node > 0; node--) {
+        pull(node);
+    }
+}
+
+template<typename Monoid = Sum<int>, typename Lazy = NoLazy<Monoid>>
+    requires SegMonoid<Monoid> && SegAction<Lazy, Monoid>
 class SegTree {
+public:
+    using T = typename Monoid::value_type;
+    using Tag = typename Lazy::tag_type;
 private:
-    std::vector<int> tree;
-    std::vector<int> nums;
+    static constexpr bool HAS_LAZY = !std::is_same_v<Lazy, NoLazy<Monoid>>;
+    std::vector<T, DefaultInitAllocator<T>> tree;
+    // Pending tag per internal node, already applied to tree[node] but not to its children
+    std::vector<Tag> lazy;
+    int n;
+    // Element i is at tree[leaves + i]
+    int leaves;
+    int log = 0;
+
+    // Number of elements below node, when leaves is a power of two
+    int length(int node) const {
+        return leaves >> (std::bit_width(static_cast<unsigned>(node)) - 1);
+    }
+    void pull(int node) {
+        tree[node] = Monoid::combine(tree[2 * node], tree[2 * node + 1]);
+    }
+    void applyTag(int node, const Tag& tag) {
+        tree[node] = Lazy::apply(tag, tree[node], length(node));
+        if (node < leaves) {
+            lazy[node] = Lazy::compose(tag, lazy[node]);
+        }
+    }
+    void push(int node) {
+        applyTag(2 * node, lazy[node]);
+        applyTag(2 * node + 1, lazy[node]);
+        lazy[node] = Lazy::identity();
+    }
 public:
-    SegTree(std::vector<int>& nums) : nums(nums), tree(4 * nums.size(), 0) {
-        // Build a segment tree
-        build(0, 0, nums.size()-1);
+    // Builds the tree on `threads` threads (see buildBottomUp)
+    SegTree(const std::vector<T>& nums, unsigned threads = 1) : n(nums.size()) {
+        leaves = n;
+        if constexpr (HAS_LAZY) {
+            leaves = std::bit_ceil(static_cast<unsigned>(std::max(n, 1)));
+            log = std::countr_zero(static_cast<unsigned>(leaves));
+            lazy.assign(leaves, Lazy::identity());
+        }
+        tree.resize(2 * leaves);
+        if (leaves > 0) {
+            tree[0] = Monoid::identity();
+        }
+        buildBottomUp(leaves, threads,
+            [&](size_t i) { tree[leaves + i] = i < nums.size() ? nums[i] : Monoid::identity(); },
+            [&](size_t node) { pull(node); });
     }
-    void build(int node, int start, int end) {
-        if (start == end) {
-            tree[node] = nums[start];
+    // Sets nums[index] to val. An index out of range is ignored.
+    void update(int index, const T& val) {
+        if (index < 0 || index >= n) {
             return;
         }
-        // Recursive case:  build both children
-        int mid = (start + end) / 2;
-        build(node*2 + 1, start, mid);
-        build(node*2 + 2, mid+1, end);
-        tree[node] = tree[node*2 + 1 ] + tree[node*2 + 2];
+        int node = index + leaves;
+        if constexpr (HAS_LAZY) {
+            for (int i = log; i > 0; i--) {
+                push(node >> i);
+            }
+        }
+        tree[node] = val;
+        for (node >>= 1; node > 0; node >>= 1) {
+            pull(node);
+        }
+    }
+    // Applies tag to every element of nums[left...right] in O(lgn)
+    void apply(int left, int right, const Tag& tag) requires HAS_LAZY {
+        if (left > right || left < 0 || right >= n) {
+            throw std::out_of_range("Invalid range");
+        }
+        int l = left + leaves;
+        int r = right + 1 + leaves;
+        // Older tags above the boundaries go down first, so tags stay in time order
+        for (int i = log; i > 0; i--) {
+            if (((l >> i) << i) != l) {
+                push(l >> i);
+            }
+            if (((r >> i) << i) != r) {
+                push((r - 1) >> i);
+            }
+        }
+        for (int a = l, b = r; a < b; a >>= 1, b >>= 1) {
+            if (a & 1) {
+                applyTag(a++, tag);
+            }
+            if (b & 1) {
+                applyTag(--b, tag);
+            }
+        }
+        for (int i = 1; i <= log; i++) {
+            if (((l >> i) << i) != l) {
+                pull(l >> i);
+            }
+            if (((r >> i) << i) != r) {
+                pull((r - 1) >> i);
+            }
+        }
+    }
+    // Returns combine(nums[left...right]) in O(lgn), or identity() for an empty range
+    T query(int left, int right) const {
+        if (left > right) {
+            return Monoid::identity();
+        }
+        if (left < 0 || right >= n) {
+            throw std::out_of_range("Invalid range");
+        }
+        // Combined separately so that a non-commutative combine keeps its order
+        T resultLeft = Monoid::identity();
+        T resultRight = Monoid::identity();
+        int lengthLeft = 0, lengthRight = 0;
+        int l = left + leaves;
+        int r = right + 1 + leaves;
+        for (int level = 0; l < r; level++) {
+            if (l & 1) {
+                resultLeft = Monoid::combine(resultLeft, tree[l++]);
+                lengthLeft += 1 << level;
+            }
+            if (r & 1) {
+                resultRight = Monoid::combine(tree[--r], resultRight);
+                lengthRight += 1 << level;
+            }
+            l >>= 1;
+            r >>= 1;
+            if constexpr (HAS_LAZY) {
+                // What resultLeft covers lies below node l - 1, and resultRight below node r
+                if (lengthLeft) {
+                    resultLeft = Lazy::apply(lazy[l - 1], resultLeft, lengthLeft);
+                }
+                if (lengthRight) {
+                    resultRight = Lazy::apply(lazy[r], resultRight, lengthRight);
+                }
+            }
+        }
+        if constexpr (HAS_LAZY) {
+            // The remaining ancestors' tags still apply to both halves
+            for (int a = l - 1, b = r; ; ) {
+                a >>= 1;
+                b >>= 1;
+                if (lengthLeft && a > 0) {
+                    resultLeft = Lazy::apply(lazy[a], resultLeft, lengthLeft);
+                }
+                if (lengthRight && b > 0) {
+                    resultRight = Lazy::apply(lazy[b], resultRight, lengthRight);
+                }
+                if (a <= 1 && b <= 1) {
+                    break;
+                }
+            }
+        }
+        return Monoid::combine(resultLeft, resultRight);
+    }
+    // Returns sum(nums[left:right+1]) in O(lgn), for Sum trees
+    T sumRange(int left, int right) const {
+        return query(left, right);
+    }
+    int size() const {
+        return n;
+    }
+};
+
+// B-ary segment tree for very large arrays. Level 0 holds the elements and level h + 1
+// holds the combine of each block of B values of level h. Blocks are aligned cache
+// lines (B = 16 ints or 8 long longs), so a query reads at most two lines per level
+// and a point update recombines one line per level, over log_B(n) levels instead of
+// the lg(n) levels whose upper nodes are scattered across a binary tree.
+template<typename Monoid = Sum<int>, size_t B = std::max<size_t>(2, 64 / sizeof(typename Monoid::value_type))>
+    requires SegMonoid<Monoid>
+class WideSegTree {
+public:
+    using T = typename Monoid::value_type;
+private:
+    struct alignas(64) Block {
+        T values[B];
+    };
+    std::vector<Block> blocks;
+    // Level h starts at blocks[offsets[h]]. The last level is a single block.
+    std::vector<size_t> offsets;
+    int n;
+
+    T& at(size_t level, size_t i) {
+        return blocks[offsets[level] + i / B].values[i % B];
+    }
+    const T& at(size_t level, size_t i) const {
+        return blocks[offsets[level] + i / B].values[i % B];
+    }
+    // Sum of values[from...to] of a block of 16 ints or 8 long longs: the whole block is
+    // loaded as two vectors and the lanes outside the range are masked off
+    static T vectorSum(const T* values, size_t from, size_t to) {
+#if defined(__AVX2__)
+        const __m256i* v = reinterpret_cast<const __m256i*>(values);
+        __m256i sum;
+        if constexpr (sizeof(T) == 4) {
+            __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            __m256i lo = _mm256_set1_epi32(static_cast<int>(from) - 1);
+            __m256i hi = _mm256_set1_epi32(static_cast<int>(to) + 1);
+            __m256i lane2 = _mm256_add_epi32(lane, _mm256_set1_epi32(8));
+            __m256i mask1 = _mm256_and_si256(_mm256_cmpgt_epi32(lane, lo), _mm256_cmpgt_epi32(hi, lane));
+            __m256i mask2 = _mm256_and_si256(_mm256_cmpgt_epi32(lane2, lo), _mm256_cmpgt_epi32(hi, lane2));
+            sum = _mm256_add_epi32(_mm256_and_si256(_mm256_load_si256(v), mask1),
+                                   _mm256_and_si256(_mm256_load_si256(v + 1), mask2));
+            __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+            return static_cast<T>(_mm_cvtsi128_si32(half));
+        } else {
+            __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+            __m256i lo = _mm256_set1_epi64x(static_cast<long long>(from) - 1);
+            __m256i hi = _mm256_set1_epi64x(static_cast<long long>(to) + 1);
+            __m256i lane2 = _mm256_add_epi64(lane, _mm256_set1_epi64x(4));
+            __m256i mask1 = _mm256_and_si256(_mm256_cmpgt_epi64(lane, lo), _mm256_cmpgt_epi64(hi, lane));
+            __m256i mask2 = _mm256_and_si256(_mm256_cmpgt_epi64(lane2, lo), _mm256_cmpgt_epi64(hi, lane2));
+            sum = _mm256_add_epi64(_mm256_and_si256(_mm256_load_si256(v), mask1),
+                                   _mm256_and_si256(_mm256_load_si256(v + 1), mask2));
+            __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            half = _mm_add_epi64(half, _mm_unpackhi_epi64(half, half));
+            return static_cast<T>(_mm_cvtsi128_si64(half));
+        }
+#else
+        T result{};
+        for (size_t i = 0; i < B; i++) {
+            result += (i >= from && i <= to) ? values[i] : T{};
+        }
+        return result;
+#endif
+    }
+    static constexpr bool VECTOR_SUM = std::is_same_v<Monoid, Sum<T>> && std::is_integral_v<T>
+        && ((sizeof(T) == 4 && B == 16) || (sizeof(T) == 8 && B == 8));
+
+    // Combine of values [from, to] of one block of a level
+    T combineRange(size_t level, size_t from, size_t to) const {
+        const T* values = blocks[offsets[level] + from / B].values;
+        if constexpr (VECTOR_SUM) {
+            return vectorSum(values, from % B, to % B);
+        }
+        T result = values[from % B];
+        for (size_t i = from % B + 1; i <= to % B; i++) {
+            result = Monoid::combine(result, values[i]);
+        }
+        return result;
+    }
+public:
+    WideSegTree(const std::vector<T>& nums) : n(nums.size()) {
+        // Count the blocks of each level, then fill the levels bottom-up
+        size_t count = std::max<size_t>(nums.size(), 1);
+        size_t total = 0;
+        while (true) {
+            size_t levelBlocks = (count + B - 1) / B;
+            offsets.push_back(total);
+            total += levelBlocks;
+            if (levelBlocks == 1) {
+                break;
+            }
+            count = levelBlocks;
+        }
+        Block empty;
+        std::fill(empty.values, empty.values + B, Monoid::identity());
+        blocks.assign(total, empty);
+        for (size_t i = 0; i < nums.size(); i++) {
+            at(0, i) = nums[i];
+        }
+        for (size_t h = 0; h + 1 < offsets.size(); h++) {
+            for (size_t b = offsets[h]; b < offsets[h + 1]; b++) {
+                at(h + 1, b - offsets[h]) = combineRange(h, (b - offsets[h]) * B, (b - offsets[h]) * B + B - 1);
+            }
+        }
     }
-    
-    void update(int index, int val) {
-        // Try iterative solution
-        if (index < 0 || index > nums.size()) {
+    // Sets nums[index] to val. An index out of range is ignored.
+    void update(int index, const T& val) {
+        if (index < 0 || index >= n) {
             return;
         }
-        int difference = val - nums[index];
-        nums[index] += difference;
-        // Traverse through implicit tree to binary search
-        int lo = 0;
-        int hi = nums.size() - 1;
-        int node = 0;
-        while (lo < hi) {
-            int mid = (lo + hi) / 2;
-            tree[node] += difference;
-            if (lo <= index && index <= mid) {
-                // recurse on the left
-                node = node * 2 + 1;
-                hi = mid;
-            } else if (mid < index && index <= hi) {
-                node = node * 2 + 2;
-                lo = mid + 1;
-            } else {
-                throw std::runtime_error("Binary search wrong");
-            }
-        }
-        // lo == hi, update final value
-        tree[node] += difference;
-    }
-    // Returns sum(nums[left:right+1]) in O(lgn)
-    int sumRange(int left, int right) {
-        return query(0, left, right, 0, nums.size() - 1);
-    }
-    int query(int node, int left, int right, int lo, int hi) {
-        // Recursively query, split into three cases:
-        // If query is completely outside node range
-        if (right < lo || left > hi) {
-            return 0;
-        }
-        // If query is completely inside node range
+        size_t i = index;
+        at(0, i) = val;
+        for (size_t h = 0; h + 1 < offsets.size(); h++) {
+            size_t first = i / B * B;
+            i /= B;
+            at(h + 1, i) = combineRange(h, first, first + B - 1);
+        }
+    }
+    // Returns combine(nums[left...right]), or identity() for an empty range
+    T query(int left, int right) const {
+        if (left > right) {
+            return Monoid::identity();
+        }
+        if (left < 0 || right >= n) {
+            throw std::out_of_range("Invalid range");
+        }
+        T resultLeft = Monoid::identity();
+        T resultRight = Monoid::identity();
+        size_t l = left, r = right;
+        for (size_t h = 0; ; h++) {
+            if (l / B == r / B) {
+                return Monoid::combine(Monoid::combine(resultLeft, combineRange(h, l, r)), resultRight);
+            }
+            // The partial blocks at both ends, then the whole blocks between them one level up
+            resultLeft = Monoid::combine(resultLeft, combineRange(h, l, l / B * B + B - 1));
+            resultRight = Monoid::combine(combineRange(h, r / B * B, r), resultRight);
+            l = l / B + 1;
+            r = r / B;
+            if (l == r) {
+                return Monoid::combine(resultLeft, resultRight);
+            }
+            r--;
+        }
+    }
+    T sumRange(int left, int right) const {
+        return query(left, right);
+    }
+    // Answers every [left, right] range, in order. The ranges move up the tree together,
+    // a level at a time: the loads of one level are independent, so their cache misses
+    // overlap, and the few blocks of the upper levels are read while they are hot.
+    std::vector<T> queryBatch(const std::vector<std::pair<int, int>>& ranges) const {
+        struct Pending {
+            size_t l, r;
+            T left, right;
+            size_t index;
+        };
+        std::vector<T> results(ranges.size(), Monoid::identity());
+        std::vector<Pending> active;
+        active.reserve(ranges.size());
+        for (size_t i = 0; i < ranges.size(); i++) {
+            auto [left, right] = ranges[i];
+            if (left > right) {
+                continue;
+            }
+            if (left < 0 || right >= n) {
+                throw std::out_of_range("Invalid range");
+            }
+            active.push_back({static_cast<size_t>(left), static_cast<size_t>(right),
+                Monoid::identity(), Monoid::identity(), i});
+        }
+        // Same steps as query, one level for every pending range at a time
+        for (size_t h = 0; !active.empty(); h++) {
+            size_t kept = 0;
+            for (Pending& p : active) {
+                if (p.l / B == p.r / B) {
+                    results[p.index] = Monoid::combine(Monoid::combine(p.left, combineRange(h, p.l, p.r)), p.right);
+                    continue;
+                }
+                p.left = Monoid::combine(p.left, combineRange(h, p.l, p.l / B * B + B - 1));
+                p.right = Monoid::combine(combineRange(h, p.r / B * B, p.r), p.right);
+                p.l = p.l / B + 1;
+                p.r = p.r / B;
+                if (p.l == p.r) {
+                    results[p.index] = Monoid::combine(p.left, p.right);
+                    continue;
+                }
+                p.r--;
+                active[kept++] = std::move(p);
+            }
+            active.resize(kept);
+        }
+        return results;
+    }
+    // Sets nums[index] = val for every (index, val), in order, so the last write to an index
+    // wins. Each block above a changed value is recombined once, however many of its
+    // values changed. Indices out of range are ignored.
+    void updateBatch(const std::vector<std::pair<int, T>>& updates) {
+        std::vector<size_t> dirty;
+        dirty.reserve(updates.size());
+        for (const auto& [index, val] : updates) {
+            if (index < 0 || index >= n) {
+                continue;
+            }
+            at(0, index) = val;
+            dirty.push_back(index / B);
+        }
+        // Sorted once: dividing by B keeps the order on every level above
+        std::sort(dirty.begin(), dirty.end());
+        for (size_t h = 0; h + 1 < offsets.size() && !dirty.empty(); h++) {
+            dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+            for (size_t& b : dirty) {
+                at(h + 1, b) = combineRange(h, b * B, b * B + B - 1);
+                b /= B;
+            }
+        }
+    }
+    int size() const {
+        return n;
+    }
+};
+
+template<typename Monoid = Sum<int>>
+    requires SegMonoid<Monoid>
+class PersistentSegTree {
+public:
+    using T = typename Monoid::value_type;
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    struct Node {
+        T value;
+        uint32_t left, right;
+        // Parents plus versions whose root this is
+        uint32_t refs;
+    };
+    // Pool of nodes. Free nodes are linked through left, starting at freeList.
+    std::vector<Node> nodes;
+    uint32_t freeList = NONE;
+    size_t liveNodes = 0;
+    // roots[v] is the root of version v, or NONE once released
+    std::vector<uint32_t> roots;
+    int n;
+
+    uint32_t allocNode(const T& value, uint32_t left, uint32_t right) {
+        uint32_t node = freeList;
+        if (node != NONE) {
+            freeList = nodes[node].left;
+            nodes[node] = {value, left, right, 1};
+        } else {
+            node = static_cast<uint32_t>(nodes.size());
+            nodes.push_back({value, left, right, 1});
+        }
+        liveNodes++;
+        return node;
+    }
+    // Drops one reference to node, freeing it and unreferencing its children when it was the last
+    void unref(uint32_t node) {
+        std::vector<uint32_t> stack = {node};
+        while (!stack.empty()) {
+            uint32_t curr = stack.back();
+            stack.pop_back();
+            if (--nodes[curr].refs > 0) {
+                continue;
+            }
+            if (nodes[curr].left != NONE) {
+                stack.push_back(nodes[curr].left);
+                stack.push_back(nodes[curr].right);
+            }
+            nodes[curr].left = freeList;
+            freeList = curr;
+            liveNodes--;
+        }
+    }
+    uint32_t build(const std::vector<T>& nums, int lo, int hi) {
+        if (lo == hi) {
+            return allocNode(nums[lo], NONE, NONE);
+        }
+        int mid = (lo + hi) / 2;
+        uint32_t left = build(nums, lo, mid);
+        uint32_t right = build(nums, mid + 1, hi);
+        return allocNode(Monoid::combine(nodes[left].value, nodes[right].value), left, right);
+    }
+    // Returns a copy of the path from node to leaf index, with val at the leaf
+    uint32_t update(uint32_t node, int lo, int hi, int index, const T& val) {
+        if (lo == hi) {
+            return allocNode(val, NONE, NONE);
+        }
+        int mid = (lo + hi) / 2;
+        uint32_t left = nodes[node].left;
+        uint32_t right = nodes[node].right;
+        // The new child is owned by the copy, the untouched one gains a parent
+        if (index <= mid) {
+            left = update(left, lo, mid, index, val);
+            nodes[right].refs++;
+        } else {
+            right = update(right, mid + 1, hi, index, val);
+            nodes[left].refs++;
+        }
+        return allocNode(Monoid::combine(nodes[left].value, nodes[right].value), left, right);
+    }
+    T query(uint32_t node, int lo, int hi, int left, int right) const {
         if (left <= lo && hi <= right) {
-            return tree[node];
+            return nodes[node].value;
         }
-        // Otherwise, examine both children.
         int mid = (lo + hi) / 2;
-        int result = query(2 * node + 1, left, right, lo, mid);
-        result += query(2 * node + 2, left, right, mid + 1, hi);
-        return result;
+        if (right <= mid) {
+            return query(nodes[node].left, lo, mid, left, right);
+        }
+        if (left > mid) {
+            return query(nodes[node].right, mid + 1, hi, left, right);
+        }
+        return Monoid::combine(query(nodes[node].left, lo, mid, left, right),
+                               query(nodes[node].right, mid + 1, hi, left, right));
+    }
+    uint32_t root(int version) const {
+        if (version < 0 || version >= static_cast<int>(roots.size()) || roots[version] == NONE) {
+            throw std::out_of_range("Invalid version");
+        }
+        return roots[version];
+    }
+public:
+    // Builds version 0 from nums
+    PersistentSegTree(const std::vector<T>& nums) : n(nums.size()) {
+        nodes.reserve(2 * nums.size());
+        // An empty array still gets a node, so that version 0 exists
+        roots.push_back(n > 0 ? build(nums, 0, n - 1) : allocNode(Monoid::identity(), NONE, NONE));
+    }
+    // Creates a version equal to version `from` except that nums[index] is val, in O(lgn)
+    // time and nodes. Returns the new version's number.
+    int update(int index, const T& val, int from) {
+        uint32_t base = root(from);
+        if (index < 0 || index >= n) {
+            throw std::out_of_range("Invalid index");
+        }
+        roots.push_back(update(base, 0, n - 1, index, val));
+        return static_cast<int>(roots.size()) - 1;
+    }
+    // Same, based on the newest version
+    int update(int index, const T& val) {
+        return update(index, val, latest());
+    }
+    // Returns combine(nums[left...right]) as of version, or identity() for an empty range
+    T query(int left, int right, int version) const {
+        uint32_t node = root(version);
+        if (left > right) {
+            return Monoid::identity();
+        }
+        if (left < 0 || right >= n) {
+            throw std::out_of_range("Invalid range");
+        }
+        return query(node, 0, n - 1, left, right);
     }
+    T sumRange(int left, int right, int version) const {
+        return query(left, right, version);
+    }
+    // Frees version. Nodes shared with versions still alive stay.
+    void release(int version) {
+        uint32_t node = root(version);
+        roots[version] = NONE;
+        unref(node);
+    }
+    // Newest version number, whether or not it has been released
+    int latest() const {
+        return static_cast<int>(roots.size()) - 1;
+    }
+    bool alive(int version) const {
+        return version >= 0 && version < static_cast<int>(roots.size()) && roots[version] != NONE;
+    }
+    size_t nodeCount() const {
+        return liveNodes;
+    }
+    int size() const {
+        return n;
+    }
+};
+
+// Bottom-up tree for many reader threads and occasional writers.
+// - readers never lock: a query reads the nodes with relaxed atomic loads between two
+//   reads of a sequence number, and retries if a write started or ended in between.
+//   So every query sees the tree as of one moment, never half of an update.
+// - writers serialize on a mutex, make the sequence number odd, update the path, and
+//   make it even again.
+// - a reader that keeps colliding with writes takes the writers' mutex after
+//   OPTIMISTIC_TRIES attempts, so a busy writer can not starve it.
+// Nodes are plain values read and written through std::atomic_ref, so the tree keeps the
+// 2n layout and the parallel build of SegTree.
+template<typename Monoid = Sum<int>>
+    requires SegMonoid<Monoid> && std::is_trivially_copyable_v<typename Monoid::value_type>
+class ConcurrentSegTree {
+public:
+    using T = typename Monoid::value_type;
+private:
+    static constexpr int OPTIMISTIC_TRIES = 8;
+    static_assert(std::atomic_ref<T>::is_always_lock_free, "Node values must be lock-free atomics");
+    static_assert(alignof(T) >= std::atomic_ref<T>::required_alignment, "Node values must be aligned for atomic_ref");
+
+    std::vector<T, DefaultInitAllocator<T>> tree;
+    int n;
+    // Odd while a write is in progress
+    std::atomic<uint64_t> seq = 0;
+    mutable std::mutex writeMutex;
 
-};
\ No newline at end of file
+    T load(int node) const {
+        return std::atomic_ref<T>(const_cast<T&>(tree[node])).load(std::memory_order_relaxed);
+    }
+    void store(int node, const T& val) {
+        std::atomic_ref<T>(tree[node]).store(val, std::memory_order_relaxed);
+    }
+    // The SegTree query loop over relaxed loads
+    T read(int left, int right) const {
+        T resultLeft = Monoid::identity();
+        T resultRight = Monoid::identity();
+        for (int l = left + n, r = right + 1 + n; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) {
+                resultLeft = Monoid::combine(resultLeft, load(l++));
+            }
+            if (r & 1) {
+                resultRight = Monoid::combine(load(--r), resultRight);
+            }
+        }
+        return Monoid::combine(resultLeft, resultRight);
+    }
+public:
+    // Builds the tree on `threads` threads (see buildBottomUp)
+    ConcurrentSegTree(const std::vector<T>& nums, unsigned threads = 1) : tree(2 * nums.size()), n(nums.size()) {
+        if (n > 0) {
+            tree[0] = Monoid::identity();
+        }
+        buildBottomUp(n, threads,
+            [&](size_t i) { tree[n + i] = nums[i]; },
+            [&](size_t node) { tree[node] = Monoid::combine(tree[2 * node], tree[2 * node + 1]); });
+    }
+    // Sets nums[index] to val. An index out of range is ignored. Safe to call from any thread.
+    void update(int index, const T& val) {
+        if (index < 0 || index >= n) {
+            return;
+        }
+        std::lock_guard lock(writeMutex);
+        uint64_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        // Keeps the node stores below from becoming visible before the odd sequence number
+        std::atomic_thread_fence(std::memory_order_release);
+        int node = index + n;
+        store(node, val);
+        for (node >>= 1; node > 0; node >>= 1) {
+            store(node, Monoid::combine(load(2 * node), load(2 * node + 1)));
+        }
+        seq.store(s + 2, std::memory_order_release);
+    }
+    // Returns combine(nums[left...right]) as of one moment, or identity() for an empty range.
+    // Safe to call from any thread.
+    T query(int left, int right) const {
+        if (left > right) {
+            return Monoid::identity();
+        }
+        if (left < 0 || right >= n) {
+            throw std::out_of_range("Invalid range");
+        }
+        for (int attempt = 0; attempt < OPTIMISTIC_TRIES; attempt++) {
+            uint64_t before = seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            T result = read(left, right);
+            // Keeps the node loads above from moving past the second sequence read
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == before) {
+                return result;
+            }
+        }
+        std::lock_guard lock(writeMutex);
+        return read(left, right);
+    }
+    T sumRange(int left, int right) const {
+        return query(left, right);
+    }
+    int size() const {
+        return n;
+    }
+};
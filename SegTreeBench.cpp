@@ -0,0 +1,353 @@
+// Benchmark for SegTree against the previous hand-written int tree.
+// Usage: ./SegTreeBench [n] [max_threads]   (defaults to 10000000 elements and 32 threads)
+// Compares the previous recursive int tree with the bottom-up SegTree and the B-ary
+// WideSegTree on build, update and sumRange. A lazy range add is then compared with
+// one point update per element. Last come WideSegTree batches of 1 to 4096 calls
+// against the same calls one at a time, and short ranges with and without vector sums.
+// Then PersistentSegTree versions against copying the whole tree for every version,
+// build time on 1 to max_threads threads, and sumRange throughput of reader threads
+// while a writer updates, for ConcurrentSegTree and for SegTree behind a std::shared_mutex.
+// Build with -march=native (or at least -mavx2) for the vector block sums.
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SegTree.cpp"
+
+// The original recursive int tree over 4n slots, kept as the baseline
+class HandSegTree {
+private:
+    std::vector<int> tree;
+    std::vector<int> nums;
+public:
+    HandSegTree(std::vector<int>& nums) : tree(4 * nums.size(), 0), nums(nums) {
+        build(0, 0, nums.size() - 1);
+    }
+    void build(int node, int start, int end) {
+        if (start == end) {
+            tree[node] = nums[start];
+            return;
+        }
+        int mid = (start + end) / 2;
+        build(node * 2 + 1, start, mid);
+        build(node * 2 + 2, mid + 1, end);
+        tree[node] = tree[node * 2 + 1] + tree[node * 2 + 2];
+    }
+    void update(int index, int val) {
+        int difference = val - nums[index];
+        nums[index] += difference;
+        int lo = 0;
+        int hi = nums.size() - 1;
+        int node = 0;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            tree[node] += difference;
+            if (index <= mid) {
+                node = node * 2 + 1;
+                hi = mid;
+            } else {
+                node = node * 2 + 2;
+                lo = mid + 1;
+            }
+        }
+        tree[node] += difference;
+    }
+    int sumRange(int left, int right) {
+        return query(0, left, right, 0, nums.size() - 1);
+    }
+    int query(int node, int left, int right, int lo, int hi) {
+        if (right < lo || left > hi) {
+            return 0;
+        }
+        if (left <= lo && hi <= right) {
+            return tree[node];
+        }
+        int mid = (lo + hi) / 2;
+        return query(2 * node + 1, left, right, lo, mid) + query(2 * node + 2, left, right, mid + 1, hi);
+    }
+};
+
+// Returns nanoseconds per operation of fn() over ops operations
+template<typename Fn>
+double timeNs(size_t ops, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+volatile long long sink;
+
+struct Op {
+    int left, right, val;
+};
+
+template<typename Tree>
+void run(const std::string& name, std::vector<int>& nums, const std::vector<Op>& ops) {
+    Tree* tree = nullptr;
+    double buildNs = timeNs(nums.size(), [&] {
+        tree = new Tree(nums);
+    });
+    double updateNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            tree->update(op.left, op.val);
+        }
+    });
+    double queryNs = timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (const Op& op : ops) {
+            total += tree->sumRange(op.left, op.right);
+        }
+        sink = total;
+    });
+    std::cout << std::format("  {:<24} build {:6.1f} ns/elem  update {:7.1f} ns  sumRange {:7.1f} ns\n",
+        name, buildNs, updateNs, queryNs);
+    delete tree;
+}
+
+// Adds to ranges of about rangeLength elements, lazily and with one point update per element
+void runRangeAdd(std::vector<long long>& nums, const std::vector<Op>& ops, int rangeLength) {
+    SegTree<Sum<long long>, RangeAdd<Sum<long long>>> lazyTree(nums);
+    SegTree<Sum<long long>> pointTree(nums);
+    auto clamp = [&](const Op& op) {
+        return std::min<int>(op.left + rangeLength - 1, nums.size() - 1);
+    };
+    double lazyNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            lazyTree.apply(op.left, clamp(op), op.val);
+        }
+    });
+    double pointNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            for (int i = op.left, right = clamp(op); i <= right; i++) {
+                nums[i] += op.val;
+                pointTree.update(i, nums[i]);
+            }
+        }
+    });
+    if (lazyTree.query(0, nums.size() - 1) != pointTree.query(0, nums.size() - 1)) {
+        std::cout << "  range add mismatch\n";
+    }
+    std::cout << std::format("  range add of {:>6} elements: lazy {:9.1f} ns  point updates {:12.1f} ns\n",
+        rangeLength, lazyNs, pointNs);
+}
+
+// Same as Sum<int> but a different type, so WideSegTree sums its blocks with the scalar loop
+struct ScalarSum : Sum<int> {};
+
+// Throughput of queryBatch/updateBatch against single calls, per batch size
+void runBatches(std::vector<int>& nums, const std::vector<Op>& ops) {
+    WideSegTree<Sum<int>> tree(nums);
+    std::cout << "WideSegTree batches, " << ops.size() << " ops per size (Mops/s)\n";
+    for (size_t batch = 1; batch <= 4096; batch *= 4) {
+        std::vector<std::pair<int, int>> ranges(batch);
+        std::vector<std::pair<int, int>> updates(batch);
+        double batchQueryNs = timeNs(ops.size(), [&] {
+            long long total = 0;
+            for (size_t start = 0; start + batch <= ops.size(); start += batch) {
+                for (size_t i = 0; i < batch; i++) {
+                    ranges[i] = {ops[start + i].left, ops[start + i].right};
+                }
+                for (int x : tree.queryBatch(ranges)) {
+                    total += x;
+                }
+            }
+            sink = total;
+        });
+        double batchUpdateNs = timeNs(ops.size(), [&] {
+            for (size_t start = 0; start + batch <= ops.size(); start += batch) {
+                for (size_t i = 0; i < batch; i++) {
+                    updates[i] = {ops[start + i].left, ops[start + i].val};
+                }
+                tree.updateBatch(updates);
+            }
+        });
+        std::cout << std::format("  batch {:>4}  queryBatch {:7.2f}  updateBatch {:7.2f}\n",
+            batch, 1e3 / batchQueryNs, 1e3 / batchUpdateNs);
+    }
+    double singleQueryNs = timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (const Op& op : ops) {
+            total += tree.query(op.left, op.right);
+        }
+        sink = total;
+    });
+    double singleUpdateNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            tree.update(op.left, op.val);
+        }
+    });
+    std::cout << std::format("  single      query      {:7.2f}  update      {:7.2f}\n",
+        1e3 / singleQueryNs, 1e3 / singleUpdateNs);
+}
+
+// Ranges of at most 16 elements, one or two blocks at the bottom level, over the first
+// 4096 elements so that the block sums are timed rather than cache misses
+template<typename Monoid>
+double shortRangeNs(std::vector<int>& nums, const std::vector<Op>& ops) {
+    std::vector<int> head(nums.begin(), nums.begin() + std::min<size_t>(nums.size(), 4096));
+    WideSegTree<Monoid> tree(head);
+    return timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (const Op& op : ops) {
+            int left = op.left % head.size();
+            total += tree.query(left, std::min<int>(left + op.val % 16, head.size() - 1));
+        }
+        sink = total;
+    });
+}
+
+// One version per update, kept either as a PersistentSegTree version or as a full copy
+// of a SegTree (the snapshot-per-version practice it replaces). Copies are capped at
+// 1 GiB so that they fit in memory.
+void runPersistent(std::vector<int>& nums, const std::vector<Op>& ops) {
+    const size_t SNAPSHOTS = std::clamp<size_t>((1ULL << 30) / (2 * nums.size() * sizeof(int) + 1), 1, 100);
+    PersistentSegTree<Sum<int>> persistent(nums);
+    double updateNs = timeNs(ops.size(), [&] {
+        for (const Op& op : ops) {
+            persistent.update(op.left, op.val);
+        }
+    });
+    double queryNs = timeNs(ops.size(), [&] {
+        long long total = 0;
+        for (size_t i = 0; i < ops.size(); i++) {
+            total += persistent.sumRange(ops[i].left, ops[i].right, static_cast<int>(ops.size() - i));
+        }
+        sink = total;
+    });
+    double bytesPerVersion = static_cast<double>(persistent.nodeCount() - (2 * nums.size() - 1))
+        * (sizeof(int) + 3 * sizeof(uint32_t)) / ops.size();
+    std::vector<SegTree<Sum<int>>> snapshots;
+    snapshots.reserve(SNAPSHOTS + 1);
+    snapshots.emplace_back(nums);
+    double copyNs = timeNs(SNAPSHOTS, [&] {
+        for (size_t i = 0; i < SNAPSHOTS; i++) {
+            snapshots.push_back(snapshots.back());
+            snapshots.back().update(ops[i].left, ops[i].val);
+        }
+    });
+    std::cout << std::format("Versions, {} updates: persistent update {:7.1f} ns  query at an old version {:7.1f} ns  {:6.1f} bytes/version\n",
+        ops.size(), updateNs, queryNs, bytesPerVersion);
+    std::cout << std::format("  full copy per version {:12.1f} ns  {:12.1f} bytes/version\n",
+        copyNs, 2.0 * nums.size() * sizeof(int));
+}
+
+void runParallelBuild(const std::vector<int>& nums, unsigned maxThreads) {
+    std::cout << "Parallel build, n=" << nums.size() << "\n";
+    double baseline = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        double ms = timeNs(1, [&] {
+            SegTree<Sum<int>> tree(nums, threads);
+            sink = tree.sumRange(0, tree.size() - 1);
+        }) / 1e6;
+        if (threads == 1) {
+            baseline = ms;
+        }
+        std::cout << std::format("  threads {:>2}  {:8.1f} ms  speedup {:5.2f}x\n", threads, ms, baseline / ms);
+    }
+}
+
+// SegTree behind a reader-writer lock, the baseline for ConcurrentSegTree
+class LockedSegTree {
+private:
+    SegTree<Sum<int>> tree;
+    mutable std::shared_mutex mutex;
+public:
+    LockedSegTree(const std::vector<int>& nums) : tree(nums) {}
+    void update(int index, int val) {
+        std::unique_lock lock(mutex);
+        tree.update(index, val);
+    }
+    int sumRange(int left, int right) const {
+        std::shared_lock lock(mutex);
+        return tree.sumRange(left, right);
+    }
+};
+
+// Reader threads run sumRange while one writer updates as fast as it can
+template<typename Tree>
+void runConcurrent(const std::string& name, const std::vector<int>& nums, const std::vector<Op>& ops, unsigned maxThreads) {
+    constexpr size_t OPS_PER_THREAD = 1000000;
+    std::cout << std::format("  {}\n", name);
+    Tree tree(nums);
+    double baseline = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        std::atomic<bool> done = false;
+        size_t written = 0;
+        std::thread writer([&] {
+            for (size_t i = 0; !done.load(std::memory_order_relaxed); i++) {
+                const Op& op = ops[i % ops.size()];
+                tree.update(op.left, op.val);
+                written++;
+            }
+        });
+        std::vector<std::thread> readers;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < threads; t++) {
+            readers.emplace_back([&, t] {
+                long long total = 0;
+                for (size_t i = t * 7919, end = i + OPS_PER_THREAD; i < end; i++) {
+                    const Op& op = ops[i % ops.size()];
+                    total += tree.sumRange(op.left, op.right);
+                }
+                sink = total;
+            });
+        }
+        for (std::thread& r : readers) {
+            r.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        done = true;
+        writer.join();
+        double mops = threads * OPS_PER_THREAD / std::chrono::duration<double, std::micro>(end - start).count();
+        if (threads == 1) {
+            baseline = mops;
+        }
+        std::cout << std::format("    readers {:>2}  {:8.2f} Mops/s  speedup {:5.2f}x  writer updates {}\n",
+            threads, mops, mops / baseline, written);
+    }
+}
+
+int main(int argc, char** argv) {
+    int n = (argc > 1) ? std::stoi(argv[1]) : 10000000;
+    unsigned maxThreads = (argc > 2) ? std::stoul(argv[2]) : 32;
+    std::mt19937 rng(42);
+    std::vector<int> nums(n);
+    for (int& x : nums) {
+        x = rng() % 1000;
+    }
+    std::vector<Op> ops(1000000);
+    for (Op& op : ops) {
+        op.left = rng() % n;
+        op.right = rng() % n;
+        if (op.left > op.right) {
+            std::swap(op.left, op.right);
+        }
+        op.val = rng() % 1000;
+    }
+    std::cout << "Point update and sumRange, n=" << n << ", " << ops.size() << " ops\n";
+    run<HandSegTree>("recursive int", nums, ops);
+    run<SegTree<Sum<int>>>("SegTree<Sum<int>>", nums, ops);
+    run<WideSegTree<Sum<int>>>("WideSegTree<Sum<int>>", nums, ops);
+    std::vector<long long> wide(nums.begin(), nums.end());
+    std::vector<Op> few(ops.begin(), ops.begin() + 1000);
+    std::cout << "Range add, " << few.size() << " ops\n";
+    for (int length : {16, 1024, 65536}) {
+        runRangeAdd(wide, few, std::min(length, n));
+    }
+    runBatches(nums, ops);
+    std::cout << std::format("Short ranges: vector block sums {:6.1f} ns  scalar block sums {:6.1f} ns\n",
+        shortRangeNs<Sum<int>>(nums, ops), shortRangeNs<ScalarSum>(nums, ops));
+    runPersistent(nums, ops);
+    runParallelBuild(nums, maxThreads);
+    std::cout << "sumRange while a writer updates\n";
+    runConcurrent<ConcurrentSegTree<Sum<int>>>("ConcurrentSegTree", nums, ops, maxThreads);
+    runConcurrent<LockedSegTree>("SegTree + std::shared_mutex", nums, ops, maxThreads);
+    return 0;
+}
@@ -0,0 +1,536 @@
+#include <vector>
+#include <iostream>
+#include <cassert>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "SegTree.cpp"
+
+// The original recursive int tree over 4n slots, kept as the oracle for the differential tests
+class RecursiveSegTree {
+private:
+    std::vector<int> tree;
+    std::vector<int> nums;
+public:
+    RecursiveSegTree(std::vector<int>& nums) : tree(4 * nums.size(), 0), nums(nums) {
+        build(0, 0, nums.size() - 1);
+    }
+    void build(int node, int start, int end) {
+        if (start == end) {
+            tree[node] = nums[start];
+            return;
+        }
+        int mid = (start + end) / 2;
+        build(node * 2 + 1, start, mid);
+        build(node * 2 + 2, mid + 1, end);
+        tree[node] = tree[node * 2 + 1] + tree[node * 2 + 2];
+    }
+    void update(int index, int val) {
+        int difference = val - nums[index];
+        nums[index] += difference;
+        int lo = 0;
+        int hi = nums.size() - 1;
+        int node = 0;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            tree[node] += difference;
+            if (index <= mid) {
+                node = node * 2 + 1;
+                hi = mid;
+            } else {
+                node = node * 2 + 2;
+                lo = mid + 1;
+            }
+        }
+        tree[node] += difference;
+    }
+    int sumRange(int left, int right) {
+        return query(0, left, right, 0, nums.size() - 1);
+    }
+    int query(int node, int left, int right, int lo, int hi) {
+        if (right < lo || left > hi) {
+            return 0;
+        }
+        if (left <= lo && hi <= right) {
+            return tree[node];
+        }
+        int mid = (lo + hi) / 2;
+        return query(2 * node + 1, left, right, lo, mid) + query(2 * node + 2, left, right, mid + 1, hi);
+    }
+};
+
+// Non-commutative, so a tree that combines out of order gives the wrong string
+struct Concat {
+    using value_type = std::string;
+    static std::string identity() { return ""; }
+    static std::string combine(const std::string& a, const std::string& b) { return a + b; }
+};
+
+void test_basic_sum_range() {
+    std::vector<int> nums = {1, 3, 5, 7, 9, 11};
+    SegTree st(nums);
+    assert(st.sumRange(0, 5) == 36);
+    assert(st.sumRange(1, 3) == 15);
+    assert(st.sumRange(4, 4) == 9);
+    st.update(1, 10);
+    assert(st.sumRange(0, 2) == 16);
+    assert(st.sumRange(1, 1) == 10);
+    std::cout << "test_basic_sum_range passed.\n";
+}
+
+// Random point updates and range sums, checked against RecursiveSegTree
+template<typename Tree>
+void test_matches_recursive(const std::string& name) {
+    std::mt19937 rng(7);
+    for (int n : {1, 2, 3, 5, 16, 17, 100, 1000, 4097}) {
+        std::vector<int> nums(n);
+        for (int& x : nums) {
+            x = static_cast<int>(rng() % 2001) - 1000;
+        }
+        RecursiveSegTree oracle(nums);
+        Tree tree(nums);
+        for (int step = 0; step < 20000; step++) {
+            int l = rng() % n;
+            int r = rng() % n;
+            if (l > r) {
+                std::swap(l, r);
+            }
+            if (rng() % 2) {
+                int val = static_cast<int>(rng() % 2001) - 1000;
+                oracle.update(l, val);
+                tree.update(l, val);
+            } else {
+                assert(tree.sumRange(l, r) == oracle.sumRange(l, r));
+            }
+        }
+    }
+    std::cout << "test_matches_recursive<" << name << "> passed.\n";
+}
+
+template<typename Tree>
+void test_non_commutative(const std::string& name) {
+    std::vector<std::string> nums;
+    for (int i = 0; i < 300; i++) {
+        nums.push_back(std::string(1, static_cast<char>('a' + i % 26)));
+    }
+    Tree tree(nums);
+    nums[123] = "XY";
+    tree.update(123, "XY");
+    for (int l = 0; l < 300; l += 7) {
+        for (int r = l; r < 300; r += 11) {
+            std::string expected;
+            for (int i = l; i <= r; i++) {
+                expected += nums[i];
+            }
+            assert(tree.query(l, r) == expected);
+        }
+    }
+    std::cout << "test_non_commutative<" << name << "> passed.\n";
+}
+
+void test_min_max_gcd() {
+    std::vector<long long> nums = {12, 18, 6, 30, 42, 9};
+    SegTree<Min<long long>> mn(nums);
+    SegTree<Max<long long>> mx(nums);
+    WideSegTree<Gcd<long long>> g(nums);
+    assert(mn.query(0, 5) == 6 && mx.query(0, 5) == 42);
+    assert(mn.query(3, 5) == 9 && mx.query(0, 2) == 18);
+    assert(g.query(0, 4) == 6 && g.query(3, 4) == 6 && g.query(0, 5) == 3);
+    g.update(5, 24);
+    assert(g.query(0, 5) == 6);
+    std::cout << "test_min_max_gcd passed.\n";
+}
+
+// Range add/assign mixed with point updates, checked against a plain array
+void test_lazy_matches_array() {
+    std::mt19937 rng(11);
+    for (int n : {1, 2, 3, 7, 8, 9, 100, 1000}) {
+        std::vector<long long> nums(n);
+        for (long long& x : nums) {
+            x = rng() % 100;
+        }
+        std::vector<long long> added = nums, assigned = nums;
+        SegTree<Sum<long long>, RangeAdd<Sum<long long>>> sum(nums);
+        SegTree<Max<long long>, RangeAdd<Max<long long>>> max(nums);
+        SegTree<Min<long long>, RangeAssign<Min<long long>>> min(nums);
+        for (int step = 0; step < 20000; step++) {
+            int l = rng() % n;
+            int r = rng() % n;
+            if (l > r) {
+                std::swap(l, r);
+            }
+            long long x = static_cast<long long>(rng() % 100) - 50;
+            switch (rng() % 4) {
+            case 0:
+                sum.apply(l, r, x);
+                max.apply(l, r, x);
+                for (int i = l; i <= r; i++) {
+                    added[i] += x;
+                }
+                break;
+            case 1:
+                min.apply(l, r, x);
+                std::fill(assigned.begin() + l, assigned.begin() + r + 1, x);
+                break;
+            case 2:
+                sum.update(l, x);
+                max.update(l, x);
+                added[l] = x;
+                min.update(r, x);
+                assigned[r] = x;
+                break;
+            default:
+                assert(sum.query(l, r) == std::accumulate(added.begin() + l, added.begin() + r + 1, 0LL));
+                assert(max.query(l, r) == *std::max_element(added.begin() + l, added.begin() + r + 1));
+                assert(min.query(l, r) == *std::min_element(assigned.begin() + l, assigned.begin() + r + 1));
+            }
+        }
+    }
+    std::cout << "test_lazy_matches_array passed.\n";
+}
+
+// Sum trees under range assign and range add, where apply depends on the length of
+// each node, mixed with point updates and checked against a plain array
+template<typename T>
+void test_sum_actions_match_array() {
+    std::mt19937 rng(17);
+    for (int n : {1, 2, 3, 6, 8, 9, 31, 32, 33, 500}) {
+        std::vector<T> nums(n);
+        for (T& x : nums) {
+            x = static_cast<T>(rng() % 201) - 100;
+        }
+        std::vector<T> assigned = nums, added = nums;
+        SegTree<Sum<T>, RangeAssign<Sum<T>>> assign(nums);
+        SegTree<Sum<T>, RangeAdd<Sum<T>>> add(nums);
+        for (int step = 0; step < 20000; step++) {
+            int l = rng() % n;
+            int r = rng() % n;
+            if (l > r) {
+                std::swap(l, r);
+            }
+            T x = static_cast<T>(rng() % 201) - 100;
+            switch (rng() % 5) {
+            case 0:
+                assign.apply(l, r, x);
+                std::fill(assigned.begin() + l, assigned.begin() + r + 1, x);
+                break;
+            case 1:
+                add.apply(l, r, x);
+                for (int i = l; i <= r; i++) {
+                    added[i] += x;
+                }
+                break;
+            case 2:
+                assign.update(r, x);
+                assigned[r] = x;
+                add.update(l, x);
+                added[l] = x;
+                break;
+            default:
+                assert(assign.query(l, r) == std::accumulate(assigned.begin() + l, assigned.begin() + r + 1, T{}));
+                assert(add.query(l, r) == std::accumulate(added.begin() + l, added.begin() + r + 1, T{}));
+                assert(assign.query(0, n - 1) == std::accumulate(assigned.begin(), assigned.end(), T{}));
+            }
+        }
+    }
+    std::cout << "test_sum_actions_match_array passed.\n";
+}
+
+// Sum modulo a prime, and x -> mul * x + add as the action. Affine tags do not commute,
+// so a tag pushed after a newer one, or composed the wrong way round, changes the answers.
+constexpr long long MOD = 1000000007;
+
+struct SumMod {
+    using value_type = long long;
+    static long long identity() { return 0; }
+    static long long combine(long long a, long long b) { return (a + b) % MOD; }
+};
+
+struct Affine {
+    using tag_type = std::pair<long long, long long>;
+    static tag_type identity() { return {1, 0}; }
+    static long long apply(const tag_type& tag, long long value, size_t length) {
+        return (tag.first * value + tag.second * static_cast<long long>(length % MOD)) % MOD;
+    }
+    static tag_type compose(const tag_type& newer, const tag_type& older) {
+        return {newer.first * older.first % MOD, (newer.first * older.second + newer.second) % MOD};
+    }
+};
+
+void test_lazy_propagation() {
+    std::mt19937 rng(13);
+    // Sizes on both sides of powers of two, so ranges end on every kind of node boundary
+    for (int n : {1, 2, 3, 4, 5, 15, 16, 17, 63, 64, 65, 300}) {
+        std::vector<long long> nums(n);
+        for (long long& x : nums) {
+            x = rng() % MOD;
+        }
+        SegTree<SumMod, Affine> tree(nums);
+        for (int step = 0; step < 5000; step++) {
+            int l = rng() % n;
+            int r = rng() % n;
+            if (l > r) {
+                std::swap(l, r);
+            }
+            switch (rng() % 4) {
+            case 0: {
+                Affine::tag_type tag = {rng() % MOD, rng() % MOD};
+                tree.apply(l, r, tag);
+                for (int i = l; i <= r; i++) {
+                    nums[i] = (tag.first * nums[i] + tag.second) % MOD;
+                }
+                break;
+            }
+            case 1: {
+                // A point update below pending tags must not have them applied on top
+                long long x = rng() % MOD;
+                tree.update(l, x);
+                nums[l] = x;
+                break;
+            }
+            default: {
+                long long expected = 0;
+                for (int i = l; i <= r; i++) {
+                    expected = (expected + nums[i]) % MOD;
+                }
+                assert(tree.query(l, r) == expected);
+                assert(tree.query(l, l) == nums[l]);
+            }
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            assert(tree.query(i, i) == nums[i]);
+        }
+    }
+
+    // Nested and overlapping ranges by hand: ((x * 2 + 1) on [0, 7], then + 3 on [2, 4]), then x * 5 on [3, 9]
+    std::vector<long long> ten(10, 1);
+    SegTree<SumMod, Affine> tree(ten);
+    tree.apply(0, 7, {2, 1});
+    tree.apply(2, 4, {1, 3});
+    tree.apply(3, 9, {5, 0});
+    std::vector<long long> expected = {3, 3, 6, 30, 30, 15, 15, 15, 5, 5};
+    for (int i = 0; i < 10; i++) {
+        assert(tree.query(i, i) == expected[i]);
+    }
+    assert(tree.query(0, 9) == 127);
+    assert(tree.query(2, 5) == 81);
+    std::cout << "test_lazy_propagation passed.\n";
+}
+
+// Batches with repeated indices and short and long ranges give the same answers as single calls
+template<typename T>
+void test_batch_matches_single() {
+    std::mt19937 rng(5);
+    for (int n : {1, 15, 16, 17, 300, 5000}) {
+        std::vector<T> nums(n);
+        for (T& x : nums) {
+            x = static_cast<T>(rng() % 2001) - 1000;
+        }
+        WideSegTree<Sum<T>> batched(nums);
+        WideSegTree<Sum<T>> single(nums);
+        for (size_t batch : {1, 7, 64, 1000}) {
+            std::vector<std::pair<int, T>> updates;
+            std::vector<std::pair<int, int>> ranges;
+            for (size_t i = 0; i < batch; i++) {
+                int index = rng() % n;
+                T val = static_cast<T>(rng() % 2001) - 1000;
+                updates.push_back({index, val});
+                single.update(index, val);
+                int l = rng() % n;
+                int r = (rng() % 2) ? std::min(n - 1, l + static_cast<int>(rng() % 20)) : static_cast<int>(rng() % n);
+                ranges.push_back({l, r});
+            }
+            batched.updateBatch(updates);
+            std::vector<T> results = batched.queryBatch(ranges);
+            for (size_t i = 0; i < batch; i++) {
+                assert(results[i] == single.query(ranges[i].first, ranges[i].second));
+            }
+        }
+    }
+    std::cout << "test_batch_matches_single passed.\n";
+}
+
+// Updates branch off random older versions, some versions get released, and every
+// live version must still match its own copy of the array
+void test_persistent_versions() {
+    std::mt19937 rng(9);
+    int n = 200;
+    std::vector<int> nums(n);
+    for (int& x : nums) {
+        x = rng() % 100;
+    }
+    PersistentSegTree tree(nums);
+    std::vector<std::vector<int>> snapshots = {nums};
+    for (int step = 0; step < 2000; step++) {
+        int from = rng() % snapshots.size();
+        if (!tree.alive(from)) {
+            continue;
+        }
+        int index = rng() % n;
+        int val = rng() % 100;
+        int version = tree.update(index, val, from);
+        assert(version == static_cast<int>(snapshots.size()));
+        snapshots.push_back(snapshots[from]);
+        snapshots.back()[index] = val;
+        int victim = rng() % snapshots.size();
+        if (rng() % 3 == 0 && tree.alive(victim)) {
+            tree.release(victim);
+        }
+    }
+    for (int v = 0; v <= tree.latest(); v++) {
+        if (!tree.alive(v)) {
+            continue;
+        }
+        for (int q = 0; q < 20; q++) {
+            int l = rng() % n;
+            int r = rng() % n;
+            if (l > r) {
+                std::swap(l, r);
+            }
+            assert(tree.sumRange(l, r, v) == std::accumulate(snapshots[v].begin() + l, snapshots[v].begin() + r + 1, 0));
+        }
+    }
+    // With one version left, only its own 2n - 1 nodes stay
+    for (int v = 0; v < tree.latest(); v++) {
+        if (tree.alive(v)) {
+            tree.release(v);
+        }
+    }
+    if (tree.alive(tree.latest())) {
+        assert(tree.nodeCount() == static_cast<size_t>(2 * n - 1));
+        tree.release(tree.latest());
+    }
+    assert(tree.nodeCount() == 0);
+    bool threw = false;
+    try {
+        tree.query(0, 0, 0);
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_persistent_versions passed.\n";
+}
+
+// Building on several threads gives the same tree as building on one
+void test_parallel_build() {
+    std::mt19937 rng(3);
+    for (int n : {static_cast<int>(PARALLEL_BUILD_MIN) + 12345, 3 * static_cast<int>(PARALLEL_BUILD_MIN)}) {
+        std::vector<int> nums(n);
+        for (int& x : nums) {
+            x = static_cast<int>(rng() % 2001) - 1000;
+        }
+        SegTree<> serial(nums);
+        SegTree<> parallel(nums, 4);
+        SegTree<Sum<int>, RangeAdd<Sum<int>>> lazy(nums, 3);
+        ConcurrentSegTree<> concurrent(nums, 4);
+        for (int q = 0; q < 20000; q++) {
+            int l = rng() % n;
+            int r = rng() % n;
+            if (l > r) {
+                std::swap(l, r);
+            }
+            int expected = serial.sumRange(l, r);
+            assert(parallel.sumRange(l, r) == expected);
+            assert(lazy.sumRange(l, r) == expected);
+            assert(concurrent.sumRange(l, r) == expected);
+        }
+    }
+    std::cout << "test_parallel_build passed.\n";
+}
+
+// The writer only ever raises values, so with consistent snapshots each reader's
+// total can never go down, and it ends at the writer's final total
+void test_concurrent_readers_and_writer() {
+    constexpr int N = 1000;
+    constexpr int READERS = 3;
+    std::vector<long long> nums(N, 0);
+    ConcurrentSegTree<Sum<long long>> tree(nums);
+    std::atomic<bool> done = false;
+    std::thread writer([&] {
+        std::vector<long long> values(N, 0);
+        for (int step = 0; step < 100000; step++) {
+            int i = (step * 7919) % N;
+            values[i] += step % 5;
+            tree.update(i, values[i]);
+        }
+        done = true;
+    });
+    std::vector<std::thread> readers;
+    for (int t = 0; t < READERS; t++) {
+        readers.emplace_back([&, t] {
+            long long last = 0;
+            std::vector<long long> lastPrefix(N / 100, 0);
+            for (int q = 0; !done.load(); q++) {
+                long long total = tree.sumRange(0, N - 1);
+                assert(total >= last);
+                last = total;
+                int k = (q + t) % lastPrefix.size();
+                long long prefix = tree.sumRange(0, k * 100 + 99);
+                assert(prefix >= lastPrefix[k] && prefix <= tree.sumRange(0, N - 1));
+                lastPrefix[k] = prefix;
+            }
+        });
+    }
+    writer.join();
+    for (std::thread& r : readers) {
+        r.join();
+    }
+    long long expected = 0;
+    for (int step = 0; step < 100000; step++) {
+        expected += step % 5;
+    }
+    assert(tree.sumRange(0, N - 1) == expected);
+    std::cout << "test_concurrent_readers_and_writer passed.\n";
+}
+
+void test_empty_and_invalid_ranges() {
+    std::vector<int> nums = {};
+    SegTree st(nums);
+    WideSegTree wide(nums);
+    ConcurrentSegTree concurrent(nums, 4);
+    assert(st.query(0, -1) == 0 && wide.query(0, -1) == 0 && concurrent.query(0, -1) == 0);
+    std::vector<int> three = {1, 2, 3};
+    SegTree<Sum<int>, RangeAdd<Sum<int>>> lazy(three);
+    bool threw = false;
+    try {
+        lazy.query(0, 3);
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        lazy.apply(-1, 1, 5);
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_empty_and_invalid_ranges passed.\n";
+}
+
+int main() {
+    test_basic_sum_range();
+    test_matches_recursive<SegTree<>>("SegTree");
+    test_matches_recursive<SegTree<Sum<int>, RangeAdd<Sum<int>>>>("SegTree with RangeAdd");
+    test_matches_recursive<WideSegTree<>>("WideSegTree");
+    test_matches_recursive<WideSegTree<Sum<int>, 4>>("WideSegTree, B=4");
+    test_non_commutative<SegTree<Concat>>("SegTree");
+    test_non_commutative<WideSegTree<Concat, 4>>("WideSegTree");
+    test_min_max_gcd();
+    test_lazy_matches_array();
+    test_sum_actions_match_array<int>();
+    test_sum_actions_match_array<long long>();
+    test_lazy_propagation();
+    test_batch_matches_single<int>();
+    test_batch_matches_single<long long>();
+    test_persistent_versions();
+    test_parallel_build();
+    test_concurrent_readers_and_writer();
+    test_empty_and_invalid_ranges();
+
+    std::cout << "All tests passed successfully.\n";
+    return 0;
+}
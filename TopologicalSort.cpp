@@ -1,7 +1,76 @@
 #include <vector>
 #include <queue>
 #include <algorithm>
-// Given an edge list representing a directed graph, 
+#include <atomic>
+#include <barrier>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// A directed graph in compressed sparse row form: the targets of node v's
+// out-edges are targets[offsets[v] ... offsets[v + 1]).
+struct CSRGraph {
+    std::vector<int> offsets;
+    std::vector<int> targets;
+
+    int numNodes() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+    int numEdges() const {
+        return targets.size();
+    }
+    // Builds the graph of edges from[i] -> to[i] by counting sort in two passes.
+    // Keeps the edge order within each node, and reuses the vectors' capacity,
+    // so rebuilding a graph of the same size allocates nothing.
+    void build(int n, const std::vector<int>& from, const std::vector<int>& to) {
+        if (n < 0 || from.size() != to.size()) {
+            throw std::invalid_argument("Edge arrays must have the same length");
+        }
+        int m = from.size();
+        // Counts the out-degrees, then turns offsets[v] into the end of v's block
+        offsets.assign(n + 1, 0);
+        for (int i = 0; i < m; i++) {
+            if ((unsigned)from[i] >= (unsigned)n || (unsigned)to[i] >= (unsigned)n) {
+                throw std::out_of_range("Edge endpoint out of range");
+            }
+            offsets[from[i]]++;
+        }
+        for (int v = 1; v <= n; v++) {
+            offsets[v] += offsets[v - 1];
+        }
+        // Fills each block from its end, walking the edges backwards, which leaves
+        // offsets[v] at the start of v's block
+        targets.resize(m);
+        for (int i = m - 1; i >= 0; i--) {
+            targets[--offsets[from[i]]] = to[i];
+        }
+    }
+};
+
+// Buffers kept between calls of the CSR topsort, so repeated sorts reuse their memory
+struct TopSortScratch {
+    CSRGraph graph;
+    std::vector<int> indegree;
+    // One output buffer per thread for topsortParallel
+    std::vector<std::vector<int>> buffers;
+};
+
+// Strongly connected components of a graph, and the DAG they form
+struct SCCResult {
+    // component[v] is the component of node v. Components are numbered in topological
+    // order of the condensation: every edge between two components goes from a lower
+    // number to a higher one, so 0, 1, ..., numComponents - 1 is a topological order.
+    std::vector<int> component;
+    int numComponents = 0;
+    // The nodes of component c are members.targets[members.offsets[c] ... members.offsets[c + 1])
+    CSRGraph members;
+    // One edge c -> d for every pair of components joined by at least one edge
+    CSRGraph condensation;
+};
+
+// Given an edge list representing a directed graph,
 // Return a topological sort or an empty array if no such sort exists.
 class TopSort {
 public:
@@ -36,4 +105,556 @@ public:
         }
         return (topsort.size() == n) ? topsort : std::vector<int>();
     }
-};
\ No newline at end of file
+
+    // Kahn's algorithm over a CSR graph. order doubles as the queue: nodes are appended
+    // when their in-degree reaches zero and read back from a head index, so the result
+    // is the order they left the queue in.
+    // Returns false and leaves order empty if the graph has a cycle.
+    // order and scratch keep their capacity, so calls on graphs no bigger than before
+    // allocate nothing.
+    bool topsort(const CSRGraph& graph, std::vector<int>& order, TopSortScratch& scratch) {
+        int n = graph.numNodes();
+        std::vector<int>& indegree = scratch.indegree;
+        indegree.assign(n, 0);
+        for (int to : graph.targets) {
+            indegree[to]++;
+        }
+        order.resize(n);
+        int tail = 0;
+        for (int i = 0; i < n; i++) {
+            if (indegree[i] == 0) {
+                order[tail++] = i;
+            }
+        }
+        for (int head = 0; head < tail; head++) {
+            int node = order[head];
+            for (int e = graph.offsets[node]; e < graph.offsets[node + 1]; e++) {
+                int out = graph.targets[e];
+                if (--indegree[out] == 0) {
+                    order[tail++] = out;
+                }
+            }
+        }
+        if (tail != n) {
+            order.clear();
+            return false;
+        }
+        return true;
+    }
+    // The same over flat edge arrays from[i] -> to[i], building the CSR graph in scratch
+    bool topsort(int n, const std::vector<int>& from, const std::vector<int>& to,
+                 std::vector<int>& order, TopSortScratch& scratch) {
+        scratch.graph.build(n, from, to);
+        return topsort(scratch.graph, order, scratch);
+    }
+    std::vector<int> topsort(int n, const std::vector<int>& from, const std::vector<int>& to) {
+        TopSortScratch scratch;
+        std::vector<int> order;
+        topsort(n, from, to, order, scratch);
+        return order;
+    }
+
+    // Level-synchronous Kahn's algorithm on `threads` threads. Each level is the range of
+    // order filled by the previous one (the sources first); the threads split it, decrement
+    // in-degrees with atomic fetch_sub, and collect the nodes they bring to zero in their own
+    // buffer. At the barrier after each level, the buffers are appended to order as the next
+    // level. The order within a level depends on the timing, but every level is complete
+    // before the next starts, so order is always a topological order.
+    // Returns false and leaves order empty if the graph has a cycle.
+    bool topsortParallel(const CSRGraph& graph, std::vector<int>& order, unsigned threads, TopSortScratch& scratch) {
+        if (threads <= 1) {
+            return topsort(graph, order, scratch);
+        }
+        int n = graph.numNodes();
+        std::vector<int>& indegree = scratch.indegree;
+        indegree.assign(n, 0);
+        order.resize(n);
+        scratch.buffers.resize(threads);
+        // The current level is order[levelBegin, levelEnd)
+        int levelBegin = 0;
+        int levelEnd = 0;
+        auto nextLevel = [&]() noexcept {
+            levelBegin = levelEnd;
+            for (std::vector<int>& buffer : scratch.buffers) {
+                std::copy(buffer.begin(), buffer.end(), order.begin() + levelEnd);
+                levelEnd += buffer.size();
+                buffer.clear();
+            }
+        };
+        std::barrier sync(threads, nextLevel);
+        auto work = [&](unsigned t) {
+            auto chunk = [&](size_t lo, size_t hi) {
+                return std::pair(lo + (hi - lo) * t / threads, lo + (hi - lo) * (t + 1) / threads);
+            };
+            std::vector<int>& buffer = scratch.buffers[t];
+            auto [firstEdge, lastEdge] = chunk(0, graph.targets.size());
+            for (size_t e = firstEdge; e < lastEdge; e++) {
+                std::atomic_ref<int>(indegree[graph.targets[e]]).fetch_add(1, std::memory_order_relaxed);
+            }
+            sync.arrive_and_wait();
+            auto [firstNode, lastNode] = chunk(0, n);
+            for (size_t v = firstNode; v < lastNode; v++) {
+                if (indegree[v] == 0) {
+                    buffer.push_back(v);
+                }
+            }
+            sync.arrive_and_wait();
+            while (levelBegin < levelEnd) {
+                auto [first, last] = chunk(levelBegin, levelEnd);
+                for (size_t i = first; i < last; i++) {
+                    int node = order[i];
+                    for (int e = graph.offsets[node]; e < graph.offsets[node + 1]; e++) {
+                        int out = graph.targets[e];
+                        if (std::atomic_ref<int>(indegree[out]).fetch_sub(1, std::memory_order_relaxed) == 1) {
+                            buffer.push_back(out);
+                        }
+                    }
+                }
+                sync.arrive_and_wait();
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++) {
+            workers.emplace_back(work, t);
+        }
+        work(0);
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        if (levelEnd != n) {
+            order.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Tarjan's algorithm with an explicit stack instead of recursion, so chains of
+    // millions of nodes can not overflow the call stack. A node's next unexplored edge
+    // is kept in an array, and all the bookkeeping is a few arrays of n ints, so the
+    // pass allocates nothing per node. O(n + m), condensation included.
+    SCCResult stronglyConnectedComponents(const CSRGraph& graph) {
+        int n = graph.numNodes();
+        SCCResult result;
+        std::vector<int>& component = result.component;
+        component.assign(n, -1);
+        // index[v] is the order v was reached in, low[v] the lowest index v reaches
+        // through nodes still on the stack
+        std::vector<int> index(n, -1);
+        std::vector<int> low(n);
+        std::vector<int> cursor(n);
+        std::vector<int> stack;
+        std::vector<int> path;
+        int reached = 0;
+        int found = 0;
+        auto visit = [&](int v) {
+            index[v] = low[v] = reached++;
+            cursor[v] = graph.offsets[v];
+            stack.push_back(v);
+            path.push_back(v);
+        };
+        for (int start = 0; start < n; start++) {
+            if (index[start] != -1) {
+                continue;
+            }
+            visit(start);
+            while (!path.empty()) {
+                int v = path.back();
+                if (cursor[v] < graph.offsets[v + 1]) {
+                    int w = graph.targets[cursor[v]++];
+                    if (index[w] == -1) {
+                        visit(w);
+                    } else if (component[w] == -1) {
+                        // w is still on the stack, so it is in v's component or an ancestor's
+                        low[v] = std::min(low[v], index[w]);
+                    }
+                    continue;
+                }
+                path.pop_back();
+                if (low[v] == index[v]) {
+                    int w;
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+                        component[w] = found;
+                    } while (w != v);
+                    found++;
+                }
+                if (!path.empty()) {
+                    low[path.back()] = std::min(low[path.back()], low[v]);
+                }
+            }
+        }
+        // Tarjan finishes components sinks first, so reversing the numbers makes them topological
+        result.numComponents = found;
+        for (int& c : component) {
+            c = found - 1 - c;
+        }
+        // Groups the nodes by component with one counting sort, filling positions from low
+        CSRGraph& members = result.members;
+        members.offsets.assign(found + 1, 0);
+        for (int c : component) {
+            members.offsets[c + 1]++;
+        }
+        for (int c = 0; c < found; c++) {
+            members.offsets[c + 1] += members.offsets[c];
+        }
+        members.targets.resize(n);
+        std::copy(members.offsets.begin(), members.offsets.end() - 1, low.begin());
+        for (int v = 0; v < n; v++) {
+            members.targets[low[component[v]]++] = v;
+        }
+        // Collects each component's outgoing edges, marking the targets already taken
+        CSRGraph& condensation = result.condensation;
+        condensation.offsets.assign(found + 1, 0);
+        std::vector<int>& taken = index;
+        std::fill(taken.begin(), taken.end(), -1);
+        for (int c = 0; c < found; c++) {
+            for (int i = members.offsets[c]; i < members.offsets[c + 1]; i++) {
+                int v = members.targets[i];
+                for (int e = graph.offsets[v]; e < graph.offsets[v + 1]; e++) {
+                    int d = component[graph.targets[e]];
+                    if (d != c && taken[d] != c) {
+                        taken[d] = c;
+                        condensation.targets.push_back(d);
+                    }
+                }
+            }
+            condensation.offsets[c + 1] = condensation.targets.size();
+        }
+        return result;
+    }
+    // Returns the nodes of one directed cycle, each with an edge to the next and the
+    // last with an edge back to the first, or an empty vector if the graph is acyclic.
+    // The cycle is a shortest one through the first node of the first component
+    // that has one (more than one node, or a self loop), found by breadth-first search
+    // inside that component.
+    std::vector<int> findCycle(const CSRGraph& graph, const SCCResult& scc) {
+        for (int c = 0; c < scc.numComponents; c++) {
+            int first = scc.members.offsets[c];
+            int last = scc.members.offsets[c + 1];
+            int start = scc.members.targets[first];
+            if (last - first == 1) {
+                for (int e = graph.offsets[start]; e < graph.offsets[start + 1]; e++) {
+                    if (graph.targets[e] == start) {
+                        return {start};
+                    }
+                }
+                continue;
+            }
+            // parent[v] is the node v was reached from; the search ends on an edge back to start
+            std::vector<int> parent(graph.numNodes(), -1);
+            std::vector<int> queue = {start};
+            parent[start] = start;
+            for (size_t head = 0; head < queue.size(); head++) {
+                int v = queue[head];
+                for (int e = graph.offsets[v]; e < graph.offsets[v + 1]; e++) {
+                    int w = graph.targets[e];
+                    if (w == start) {
+                        std::vector<int> cycle;
+                        for (int u = v; u != start; u = parent[u]) {
+                            cycle.push_back(u);
+                        }
+                        cycle.push_back(start);
+                        std::reverse(cycle.begin(), cycle.end());
+                        return cycle;
+                    }
+                    if (parent[w] == -1 && scc.component[w] == c) {
+                        parent[w] = v;
+                        queue.push_back(w);
+                    }
+                }
+            }
+        }
+        return {};
+    }
+    // The cycle findCycle reports, computing the components first
+    std::vector<int> findCycle(const CSRGraph& graph) {
+        return findCycle(graph, stronglyConnectedComponents(graph));
+    }
+};
+
+// Runs one task per node of a DAG on a pool of threads, each task as soon as the tasks
+// of all its predecessors have returned.
+// - every worker owns a deque of ready nodes. It takes from the back of its own deque
+//   (the tasks it just made ready, likely still in its cache) and, when that is empty,
+//   steals from the front of the others'. Each deque has its own mutex, held only to
+//   push or pop one node.
+// - a finished task decrements its successors' remaining-dependency counts with atomic
+//   fetch_sub; the worker that brings one to zero pushes it on its own deque.
+// - a worker that finds no ready node sleeps in std::atomic::wait on a wake counter,
+//   instead of spinning. A task that makes more than one node ready, the last task and
+//   a failing task bump the counter, and only then is anyone notified, only if some
+//   worker sleeps. A chain of single successors never wakes anyone.
+// - if a task throws, no new tasks start, and run rethrows the first exception once the
+//   running ones have returned.
+class DagExecutor {
+private:
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<int> ready;
+    };
+    const CSRGraph& graph;
+    std::vector<int> indegree;
+    std::vector<int> sources;
+
+    static bool popBack(Worker& worker, int& node) {
+        std::lock_guard lock(worker.mutex);
+        if (worker.ready.empty()) {
+            return false;
+        }
+        node = worker.ready.back();
+        worker.ready.pop_back();
+        return true;
+    }
+    static bool popFront(Worker& worker, int& node) {
+        std::lock_guard lock(worker.mutex);
+        if (worker.ready.empty()) {
+            return false;
+        }
+        node = worker.ready.front();
+        worker.ready.pop_front();
+        return true;
+    }
+
+public:
+    // Keeps a reference to graph, which must outlive the executor.
+    // Throws invalid_argument if the graph has a cycle, since its tasks could never all run.
+    DagExecutor(const CSRGraph& graph) : graph(graph), indegree(graph.numNodes(), 0) {
+        TopSortScratch scratch;
+        std::vector<int> order;
+        if (!TopSort().topsort(graph, order, scratch)) {
+            throw std::invalid_argument("DagExecutor graph has a cycle");
+        }
+        for (int to : graph.targets) {
+            indegree[to]++;
+        }
+        for (int v = 0; v < graph.numNodes(); v++) {
+            if (indegree[v] == 0) {
+                sources.push_back(v);
+            }
+        }
+    }
+    // Calls task(v) for every node v on `threads` threads (the calling thread included),
+    // and returns when all of them have returned. Can be called again to rerun the graph.
+    template<typename Task>
+    void run(Task&& task, unsigned threads) {
+        threads = std::max(1u, threads);
+        int n = graph.numNodes();
+        std::vector<int> remaining = indegree;
+        std::vector<Worker> workers(threads);
+        for (size_t i = 0; i < sources.size(); i++) {
+            workers[i % threads].ready.push_back(sources[i]);
+        }
+        std::atomic<int> unfinished = n;
+        std::atomic<bool> failed = false;
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        // Bumped after new nodes are pushed and when the run ends. A worker reads it before
+        // looking for a node and sleeps only while it is unchanged, so no push is missed.
+        std::atomic<unsigned> wakes = 0;
+        std::atomic<unsigned> sleeping = 0;
+        auto wake = [&](unsigned count) {
+            wakes.fetch_add(1);
+            if (sleeping.load() == 0) {
+                return;
+            }
+            if (count >= threads - 1) {
+                wakes.notify_all();
+            } else {
+                for (unsigned i = 0; i < count; i++) {
+                    wakes.notify_one();
+                }
+            }
+        };
+        auto work = [&](unsigned t) {
+            Worker& self = workers[t];
+            while (true) {
+                unsigned seen = wakes.load();
+                if (unfinished.load(std::memory_order_acquire) == 0 || failed.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                int node;
+                bool found = popBack(self, node);
+                for (unsigned k = 1; !found && k < threads; k++) {
+                    found = popFront(workers[(t + k) % threads], node);
+                }
+                if (!found) {
+                    sleeping.fetch_add(1);
+                    wakes.wait(seen);
+                    sleeping.fetch_sub(1);
+                    continue;
+                }
+                try {
+                    task(node);
+                } catch (...) {
+                    {
+                        std::lock_guard lock(errorMutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                    failed = true;
+                    wake(threads);
+                    return;
+                }
+                unsigned pushed = 0;
+                for (int e = graph.offsets[node]; e < graph.offsets[node + 1]; e++) {
+                    int out = graph.targets[e];
+                    // acq_rel so the task of `out` sees the writes of every task before it
+                    if (std::atomic_ref<int>(remaining[out]).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        std::lock_guard lock(self.mutex);
+                        self.ready.push_back(out);
+                        pushed++;
+                    }
+                }
+                if (unfinished.fetch_sub(1, std::memory_order_release) == 1) {
+                    wake(threads);
+                } else if (pushed > 1) {
+                    // This worker runs one of them itself
+                    wake(pushed - 1);
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++) {
+            pool.emplace_back(work, t);
+        }
+        work(0);
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+// Keeps a topological order of a DAG while edges are added one at a time
+// (Pearce-Kelly). Adding from -> to when from already comes first costs O(1).
+// Otherwise only the nodes positioned between to and from can need to move:
+// a forward search from `to` and a backward search from `from`, both limited to
+// that window, find them, and they are reassigned the same set of positions with
+// the backward set first. If the forward search reaches `from`, the edge would
+// close a cycle, so it is rejected and nothing changes.
+class DynamicTopologicalOrder {
+private:
+    std::vector<std::vector<int>> out;
+    std::vector<std::vector<int>> in;
+    // position[v] is v's index in nodes
+    std::vector<int> position;
+    std::vector<int> nodes;
+    // visited[v] == stamp marks v as seen by the current insertion
+    std::vector<unsigned> visited;
+    unsigned stamp = 0;
+    // Buffers reused by every insertion
+    std::vector<int> stack;
+    std::vector<int> forward;
+    std::vector<int> backward;
+    std::vector<int> slots;
+
+    // Collects the nodes reachable from start along edges (out, or in when backwards)
+    // whose position lies within [lo, hi]. Returns false if it reaches stop.
+    bool search(int start, int stop, int lo, int hi, const std::vector<std::vector<int>>& edges, std::vector<int>& found) {
+        found.clear();
+        stack.assign(1, start);
+        visited[start] = stamp;
+        while (!stack.empty()) {
+            int node = stack.back();
+            stack.pop_back();
+            found.push_back(node);
+            for (int next : edges[node]) {
+                if (next == stop) {
+                    return false;
+                }
+                if (visited[next] != stamp && position[next] >= lo && position[next] <= hi) {
+                    visited[next] = stamp;
+                    stack.push_back(next);
+                }
+            }
+        }
+        return true;
+    }
+    void checkNode(int v) const {
+        if (v < 0 || v >= (int)nodes.size()) {
+            throw std::out_of_range("Node out of range");
+        }
+    }
+
+public:
+    // Starts with n nodes, no edges, in the order 0, 1, ..., n - 1
+    DynamicTopologicalOrder(int n) {
+        if (n < 0) {
+            throw std::invalid_argument("Node count must not be negative");
+        }
+        for (int v = 0; v < n; v++) {
+            addNode();
+        }
+    }
+    // Adds a node with no edges at the end of the order, returns its id
+    int addNode() {
+        int v = nodes.size();
+        out.emplace_back();
+        in.emplace_back();
+        position.push_back(v);
+        nodes.push_back(v);
+        visited.push_back(0);
+        return v;
+    }
+    // Adds the edge from -> to and updates the order.
+    // Returns false, leaving the graph unchanged, if the edge would create a cycle.
+    bool addEdge(int from, int to) {
+        checkNode(from);
+        checkNode(to);
+        if (from == to) {
+            return false;
+        }
+        int lo = position[to];
+        int hi = position[from];
+        if (lo < hi) {
+            if (++stamp == 0) {
+                std::fill(visited.begin(), visited.end(), 0);
+                stamp = 1;
+            }
+            if (!search(to, from, lo, hi, out, forward)) {
+                return false;
+            }
+            search(from, -1, lo, hi, in, backward);
+            // The moved nodes keep their relative order and take the same positions,
+            // everything that reaches `from` before everything `to` reaches
+            auto byPosition = [this](int a, int b) { return position[a] < position[b]; };
+            std::sort(forward.begin(), forward.end(), byPosition);
+            std::sort(backward.begin(), backward.end(), byPosition);
+            slots.clear();
+            for (int v : backward) {
+                slots.push_back(position[v]);
+            }
+            for (int v : forward) {
+                slots.push_back(position[v]);
+            }
+            std::sort(slots.begin(), slots.end());
+            size_t next = 0;
+            for (int v : backward) {
+                position[v] = slots[next];
+                nodes[slots[next++]] = v;
+            }
+            for (int v : forward) {
+                position[v] = slots[next];
+                nodes[slots[next++]] = v;
+            }
+        }
+        out[from].push_back(to);
+        in[to].push_back(from);
+        return true;
+    }
+    // The nodes in topological order
+    const std::vector<int>& order() const {
+        return nodes;
+    }
+    int positionOf(int v) const {
+        checkNode(v);
+        return position[v];
+    }
+    int numNodes() const {
+        return nodes.size();
+    }
+};
@@ -0,0 +1,247 @@
+// Benchmark for the CSR TopSort overloads against the vector<vector<int>> version.
+// Usage: ./TopologicalSortBench [n] [m] [repeats] [max_threads]
+//   (defaults to 1000000 nodes, 10000000 edges, 5 calls and 32 threads)
+// Sorts the same random DAG repeatedly, as a build scheduler re-sorting its graph would:
+// with the adjacency-list version, from flat edge arrays with reused scratch buffers
+// (CSR rebuilt every call), and from a prebuilt CSR graph.
+// Then streams random DAG edges one at a time into DynamicTopologicalOrder, against
+// re-sorting the flat edge arrays with reused scratch after every edge. On the larger
+// streams the re-sort cost is estimated from one sort of the final graph.
+// Then on wide layered DAGs: topsortParallel on 1 to max_threads threads against topsort,
+// and DagExecutor running busy tasks against calling them in topological order.
+// Last, stronglyConnectedComponents and findCycle on a random graph with cycles of the
+// same size as the first DAG, and on a single cycle through all n nodes.
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "TopologicalSort.cpp"
+
+// Returns milliseconds per call of fn() over calls calls
+template<typename Fn>
+double timeMs(int calls, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / calls;
+}
+
+volatile long long sink;
+
+// Edges of a random DAG, in random order: each goes from the earlier to the later
+// node of a shuffled ranking, so no insertion is ever rejected
+void randomDagEdges(int n, int m, std::mt19937& rng, std::vector<int>& from, std::vector<int>& to) {
+    std::vector<int> rank(n);
+    std::iota(rank.begin(), rank.end(), 0);
+    std::shuffle(rank.begin(), rank.end(), rng);
+    from.resize(m);
+    to.resize(m);
+    for (int e = 0; e < m; e++) {
+        int a = rng() % n;
+        int b = rng() % (n - 1);
+        b += (b >= a);
+        from[e] = rank[std::min(a, b)];
+        to[e] = rank[std::max(a, b)];
+    }
+}
+
+void runStreaming(int n, int m, std::mt19937& rng) {
+    std::vector<int> from, to;
+    randomDagEdges(n, m, rng, from, to);
+    DynamicTopologicalOrder dynamic(n);
+    double dynamicUs = timeMs(1, [&] {
+        for (int e = 0; e < m; e++) {
+            dynamic.addEdge(from[e], to[e]);
+        }
+    }) * 1000 / m;
+    TopSort ts;
+    TopSortScratch scratch;
+    std::vector<int> order;
+    std::vector<int> prefixFrom, prefixTo;
+    double resortUs;
+    std::string how = "";
+    if ((long long)m * m <= 100000000LL) {
+        resortUs = timeMs(1, [&] {
+            for (int e = 0; e < m; e++) {
+                prefixFrom.push_back(from[e]);
+                prefixTo.push_back(to[e]);
+                sink = ts.topsort(n, prefixFrom, prefixTo, order, scratch);
+            }
+        }) * 1000 / m;
+    } else {
+        // The graph grows linearly, so the average re-sort is about half of the final one
+        resortUs = timeMs(3, [&] {
+            sink = ts.topsort(n, from, to, order, scratch);
+        }) * 1000 / 2;
+        how = " (estimated)";
+    }
+    std::cout << std::format("  n={:<8} m={:<9} DynamicTopologicalOrder {:8.2f} us/edge  re-sort per edge {:10.2f} us/edge{}\n",
+        n, m, dynamicUs, resortUs, how);
+}
+
+// layers x width nodes; every node past the first layer depends on `fanIn` random nodes
+// of the layer before
+void layeredDag(int layers, int width, int fanIn, std::mt19937& rng, CSRGraph& graph) {
+    std::vector<int> from, to;
+    for (int layer = 1; layer < layers; layer++) {
+        for (int i = 0; i < width; i++) {
+            for (int k = 0; k < fanIn; k++) {
+                from.push_back((layer - 1) * width + rng() % width);
+                to.push_back(layer * width + i);
+            }
+        }
+    }
+    graph.build(layers * width, from, to);
+}
+
+// Spins for about `iterations` dependent multiply-adds, standing in for a task's work
+long long busyWork(int node, int iterations) {
+    unsigned long long x = node;
+    for (int i = 0; i < iterations; i++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    return x;
+}
+
+void runParallel(std::mt19937& rng, unsigned maxThreads, int repeats) {
+    CSRGraph graph;
+    layeredDag(100, 10000, 4, rng, graph);
+    std::cout << std::format("Wide DAG, 100 layers of 10000 nodes, {} edges\n", graph.numEdges());
+    TopSort ts;
+    TopSortScratch scratch;
+    std::vector<int> order;
+    double sequentialMs = timeMs(repeats, [&] {
+        sink = ts.topsort(graph, order, scratch);
+    });
+    std::cout << std::format("  topsort                     {:8.1f} ms\n", sequentialMs);
+    for (unsigned threads = 2; threads <= maxThreads; threads *= 2) {
+        double parallelMs = timeMs(repeats, [&] {
+            sink = ts.topsortParallel(graph, order, threads, scratch);
+        });
+        std::cout << std::format("  topsortParallel, threads {:>2} {:8.1f} ms  speedup {:5.2f}x\n",
+            threads, parallelMs, sequentialMs / parallelMs);
+    }
+
+    constexpr int WORK = 2000;
+    layeredDag(50, 2000, 4, rng, graph);
+    ts.topsort(graph, order, scratch);
+    std::cout << std::format("Tasks of {} multiply-adds, 50 layers of 2000 nodes, {} edges\n", WORK, graph.numEdges());
+    double inOrderMs = timeMs(1, [&] {
+        long long total = 0;
+        for (int v : order) {
+            total += busyWork(v, WORK);
+        }
+        sink = total;
+    });
+    std::cout << std::format("  in topological order        {:8.1f} ms\n", inOrderMs);
+    DagExecutor executor(graph);
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        double executorMs = timeMs(1, [&] {
+            std::atomic<long long> total = 0;
+            executor.run([&](int v) {
+                total.fetch_add(busyWork(v, WORK), std::memory_order_relaxed);
+            }, threads);
+            sink = total;
+        });
+        std::cout << std::format("  DagExecutor, threads {:>2}     {:8.1f} ms  speedup {:5.2f}x\n",
+            threads, executorMs, inOrderMs / executorMs);
+    }
+}
+
+void runComponents(int n, int m, std::mt19937& rng, int repeats) {
+    std::vector<int> from(m), to(m);
+    for (int e = 0; e < m; e++) {
+        from[e] = rng() % n;
+        to[e] = rng() % n;
+    }
+    CSRGraph graph;
+    graph.build(n, from, to);
+    TopSort ts;
+    SCCResult scc;
+    double sccMs = timeMs(repeats, [&] {
+        scc = ts.stronglyConnectedComponents(graph);
+    });
+    size_t cycleLength = 0;
+    double cycleMs = timeMs(repeats, [&] {
+        cycleLength = ts.findCycle(graph, scc).size();
+    });
+    std::cout << std::format("  random graph, n={} m={}: {} components, condensation {} edges\n",
+        n, m, scc.numComponents, scc.condensation.numEdges());
+    std::cout << std::format("    stronglyConnectedComponents {:8.1f} ms  findCycle {:8.1f} ms (length {})\n",
+        sccMs, cycleMs, cycleLength);
+    for (int v = 0; v < n; v++) {
+        from[v] = v;
+        to[v] = (v + 1) % n;
+    }
+    from.resize(n);
+    to.resize(n);
+    graph.build(n, from, to);
+    sccMs = timeMs(repeats, [&] {
+        scc = ts.stronglyConnectedComponents(graph);
+    });
+    cycleMs = timeMs(repeats, [&] {
+        cycleLength = ts.findCycle(graph, scc).size();
+    });
+    std::cout << std::format("  one cycle through all {} nodes\n", n);
+    std::cout << std::format("    stronglyConnectedComponents {:8.1f} ms  findCycle {:8.1f} ms (length {})\n",
+        sccMs, cycleMs, cycleLength);
+}
+
+int main(int argc, char** argv) {
+    int n = (argc > 1) ? std::stoi(argv[1]) : 1000000;
+    int m = (argc > 2) ? std::stoi(argv[2]) : 10000000;
+    int repeats = (argc > 3) ? std::stoi(argv[3]) : 5;
+    unsigned maxThreads = (argc > 4) ? std::stoul(argv[4]) : 32;
+    std::mt19937 rng(42);
+    // Edges go from earlier to later nodes of a shuffled ranking
+    std::vector<int> rank(n);
+    std::iota(rank.begin(), rank.end(), 0);
+    std::shuffle(rank.begin(), rank.end(), rng);
+    std::vector<int> from(m), to(m);
+    std::vector<std::vector<int>> edges(m);
+    for (int e = 0; e < m; e++) {
+        int a = rng() % n;
+        int b = rng() % (n - 1);
+        b += (b >= a);
+        from[e] = rank[std::min(a, b)];
+        to[e] = rank[std::max(a, b)];
+        edges[e] = {from[e], to[e]};
+    }
+    std::cout << "Random DAG, n=" << n << ", m=" << m << ", " << repeats << " calls each\n";
+    TopSort ts;
+    double adjacencyMs = timeMs(repeats, [&] {
+        sink = ts.topsort(n, edges).size();
+    });
+    TopSortScratch scratch;
+    std::vector<int> order;
+    // One warm-up call sizes the buffers
+    ts.topsort(n, from, to, order, scratch);
+    double flatMs = timeMs(repeats, [&] {
+        sink = ts.topsort(n, from, to, order, scratch);
+    });
+    double buildMs = timeMs(repeats, [&] {
+        scratch.graph.build(n, from, to);
+    });
+    double csrMs = timeMs(repeats, [&] {
+        sink = ts.topsort(scratch.graph, order, scratch);
+    });
+    std::cout << std::format("  vector<vector<int>> edges      {:8.1f} ms\n", adjacencyMs);
+    std::cout << std::format("  flat edges, reused scratch     {:8.1f} ms  ({:.1f}x)\n", flatMs, adjacencyMs / flatMs);
+    std::cout << std::format("    of which CSR build           {:8.1f} ms\n", buildMs);
+    std::cout << std::format("  prebuilt CSR graph             {:8.1f} ms  ({:.1f}x)\n", csrMs, adjacencyMs / csrMs);
+    std::cout << "Edges added one at a time\n";
+    runStreaming(1000, 5000, rng);
+    runStreaming(10000, 10000, rng);
+    runStreaming(100000, 1000000, rng);
+    runParallel(rng, maxThreads, repeats);
+    std::cout << "Strongly connected components\n";
+    runComponents(n, m, rng, repeats);
+    return 0;
+}
@@ -0,0 +1,414 @@
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <ctime>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TopologicalSort.cpp"
+
+// Returns whether order lists every node once with each edge pointing forward
+bool isTopologicalOrder(int n, const std::vector<int>& from, const std::vector<int>& to, const std::vector<int>& order) {
+    if ((int)order.size() != n) {
+        return false;
+    }
+    std::vector<int> position(n, -1);
+    for (int i = 0; i < n; i++) {
+        if (order[i] < 0 || order[i] >= n || position[order[i]] != -1) {
+            return false;
+        }
+        position[order[i]] = i;
+    }
+    for (size_t e = 0; e < from.size(); e++) {
+        if (position[from[e]] >= position[to[e]]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A random DAG: edges go from earlier to later nodes of a shuffled ranking
+void randomDag(int n, int m, std::mt19937& rng, std::vector<int>& from, std::vector<int>& to) {
+    std::vector<int> rank(n);
+    std::iota(rank.begin(), rank.end(), 0);
+    std::shuffle(rank.begin(), rank.end(), rng);
+    from.clear();
+    to.clear();
+    for (int e = 0; e < m; e++) {
+        int a = rng() % n;
+        int b = rng() % n;
+        if (a == b) {
+            continue;
+        }
+        from.push_back(rank[std::min(a, b)]);
+        to.push_back(rank[std::max(a, b)]);
+    }
+}
+
+void test_small_graphs() {
+    TopSort ts;
+    std::vector<std::vector<int>> edges = {{0, 1}, {1, 2}, {0, 2}, {3, 1}};
+    std::vector<int> order = ts.topsort(4, edges);
+    assert(isTopologicalOrder(4, {0, 1, 0, 3}, {1, 2, 2, 1}, order));
+    assert(ts.topsort(4, {0, 1, 0, 3}, {1, 2, 2, 1}) == order);
+
+    std::vector<std::vector<int>> cycle = {{0, 1}, {1, 2}, {2, 0}};
+    assert(ts.topsort(3, cycle).empty());
+    assert(ts.topsort(3, {0, 1, 2}, {1, 2, 0}).empty());
+    assert(ts.topsort(0, {}, {}).empty());
+    assert(ts.topsort(1, {0}, {0}).empty());  // Self loop
+    std::cout << "test_small_graphs passed.\n";
+}
+
+void test_csr_build() {
+    CSRGraph graph;
+    graph.build(4, {2, 0, 2, 1, 0}, {3, 1, 0, 3, 2});
+    assert(graph.numNodes() == 4);
+    assert(graph.numEdges() == 5);
+    assert((graph.offsets == std::vector<int>{0, 2, 3, 5, 5}));
+    // Edges keep their input order within a node
+    assert((graph.targets == std::vector<int>{1, 2, 3, 3, 0}));
+
+    bool threw = false;
+    try {
+        graph.build(2, {0, 1}, {1});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        graph.build(2, {0, 2}, {1, 0});
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_csr_build passed.\n";
+}
+
+void test_matches_adjacency_version() {
+    std::mt19937 rng(37);
+    TopSort ts;
+    TopSortScratch scratch;
+    std::vector<int> order;
+    std::vector<int> from, to;
+    for (int round = 0; round < 50; round++) {
+        int n = 1 + rng() % 300;
+        randomDag(n, rng() % (4 * n), rng, from, to);
+        std::vector<std::vector<int>> edges;
+        for (size_t e = 0; e < from.size(); e++) {
+            edges.push_back({from[e], to[e]});
+        }
+        // Both run Kahn's algorithm in the same FIFO order
+        assert(ts.topsort(n, from, to, order, scratch));
+        assert(isTopologicalOrder(n, from, to, order));
+        assert(order == ts.topsort(n, edges));
+
+        // Closing a cycle makes both fail
+        if (!from.empty()) {
+            from.push_back(to[0]);
+            to.push_back(from[0]);
+            assert(!ts.topsort(n, from, to, order, scratch));
+            assert(order.empty());
+        }
+    }
+    std::cout << "test_matches_adjacency_version passed.\n";
+}
+
+void test_dynamic_order() {
+    DynamicTopologicalOrder dynamic(4);
+    assert(dynamic.addEdge(2, 1));
+    assert(dynamic.addEdge(3, 2));
+    assert(dynamic.addEdge(1, 0));
+    assert((dynamic.order() == std::vector<int>{3, 2, 1, 0}));
+    assert(!dynamic.addEdge(0, 3));  // Would close 3 -> 2 -> 1 -> 0 -> 3
+    assert(!dynamic.addEdge(1, 1));
+    assert((dynamic.order() == std::vector<int>{3, 2, 1, 0}));
+    int added = dynamic.addNode();
+    assert(added == 4 && dynamic.positionOf(4) == 4);
+    assert(dynamic.addEdge(4, 3));
+    assert(dynamic.positionOf(4) < dynamic.positionOf(3));
+    bool threw = false;
+    try {
+        dynamic.addEdge(0, 5);
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Random edges, accepted exactly when the target can not already reach the source
+    std::mt19937 rng(41);
+    const int n = 60;
+    DynamicTopologicalOrder order(n);
+    std::vector<int> from, to;
+    std::vector<std::vector<int>> adjacent(n);
+    auto reaches = [&](int start, int goal) {
+        std::vector<bool> seen(n);
+        std::vector<int> stack = {start};
+        seen[start] = true;
+        while (!stack.empty()) {
+            int v = stack.back();
+            stack.pop_back();
+            if (v == goal) {
+                return true;
+            }
+            for (int w : adjacent[v]) {
+                if (!seen[w]) {
+                    seen[w] = true;
+                    stack.push_back(w);
+                }
+            }
+        }
+        return false;
+    };
+    for (int step = 0; step < 1500; step++) {
+        int a = rng() % n;
+        int b = rng() % n;
+        bool acyclic = !reaches(b, a);
+        assert(order.addEdge(a, b) == acyclic);
+        if (acyclic) {
+            from.push_back(a);
+            to.push_back(b);
+            adjacent[a].push_back(b);
+        }
+        assert(isTopologicalOrder(n, from, to, order.order()));
+        for (int v = 0; v < n; v++) {
+            assert(order.order()[order.positionOf(v)] == v);
+        }
+    }
+    std::cout << "test_dynamic_order passed.\n";
+}
+
+void test_parallel_topsort() {
+    std::mt19937 rng(43);
+    TopSort ts;
+    TopSortScratch scratch;
+    std::vector<int> order;
+    std::vector<int> from, to;
+    CSRGraph graph;
+    for (int round = 0; round < 30; round++) {
+        int n = 1 + rng() % 2000;
+        randomDag(n, rng() % (5 * n), rng, from, to);
+        graph.build(n, from, to);
+        for (unsigned threads : {1u, 2u, 3u, 8u}) {
+            assert(ts.topsortParallel(graph, order, threads, scratch));
+            assert(isTopologicalOrder(n, from, to, order));
+        }
+        if (!from.empty()) {
+            from.push_back(to.back());
+            to.push_back(from[from.size() - 2]);
+            graph.build(n, from, to);
+            assert(!ts.topsortParallel(graph, order, 4, scratch));
+            assert(order.empty());
+        }
+    }
+    graph.build(0, {}, {});
+    assert(ts.topsortParallel(graph, order, 4, scratch) && order.empty());
+    std::cout << "test_parallel_topsort passed.\n";
+}
+
+void test_dag_executor() {
+    std::mt19937 rng(47);
+    std::vector<int> from, to;
+    const int n = 3000;
+    randomDag(n, 4 * n, rng, from, to);
+    CSRGraph graph;
+    graph.build(n, from, to);
+    DagExecutor executor(graph);
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        // Each task records when it ran; every predecessor must have finished first
+        std::atomic<int> clock = 0;
+        std::vector<int> started(n, -1);
+        std::vector<int> finished(n, -1);
+        executor.run([&](int v) {
+            started[v] = clock++;
+            finished[v] = clock++;
+        }, threads);
+        for (int v = 0; v < n; v++) {
+            assert(started[v] >= 0);
+        }
+        for (size_t e = 0; e < from.size(); e++) {
+            assert(finished[from[e]] < started[to[e]]);
+        }
+    }
+
+    // A chain makes one node ready at a time and a star makes them all ready at once
+    for (bool chain : {true, false}) {
+        std::vector<int> a, b;
+        for (int v = 1; v < n; v++) {
+            a.push_back(chain ? v - 1 : 0);
+            b.push_back(v);
+        }
+        CSRGraph shape;
+        shape.build(n, a, b);
+        DagExecutor shaped(shape);
+        std::vector<int> order;
+        std::mutex orderMutex;
+        shaped.run([&](int v) {
+            std::lock_guard lock(orderMutex);
+            order.push_back(v);
+        }, 4);
+        assert((int)order.size() == n && order[0] == 0);
+        if (chain) {
+            for (int v = 0; v < n; v++) {
+                assert(order[v] == v);
+            }
+        }
+    }
+
+    // Idle workers sleep instead of spinning while the only task runs
+    CSRGraph pair;
+    pair.build(2, {0}, {1});
+    DagExecutor slow(pair);
+    std::clock_t cpuStart = std::clock();
+    slow.run([](int v) {
+        if (v == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        }
+    }, 4);
+    double cpuMs = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    assert(cpuMs < 100);
+
+    // A throwing task stops the run, and run rethrows its exception
+    std::atomic<int> ran = 0;
+    bool threw = false;
+    try {
+        executor.run([&](int v) {
+            ran++;
+            if (v == from[0]) {
+                throw std::runtime_error("task failed");
+            }
+        }, 4);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(ran < n);
+
+    threw = false;
+    graph.build(2, {0, 1}, {1, 0});
+    try {
+        DagExecutor cyclic(graph);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_dag_executor passed.\n";
+}
+
+void test_strongly_connected_components() {
+    TopSort ts;
+    CSRGraph graph;
+    // {0,1,2} is a cycle feeding {3,4}, which feeds 5; 6 has a self loop
+    graph.build(7, {0, 1, 2, 2, 3, 4, 4, 1, 6}, {1, 2, 0, 3, 4, 3, 5, 3, 6});
+    SCCResult scc = ts.stronglyConnectedComponents(graph);
+    assert(scc.numComponents == 4);
+    assert(scc.component[0] == scc.component[1] && scc.component[1] == scc.component[2]);
+    assert(scc.component[3] == scc.component[4]);
+    assert(scc.component[0] < scc.component[3] && scc.component[3] < scc.component[5]);
+    // Two edges join {0,1,2} to {3,4}, but the condensation keeps one
+    int c = scc.component[0];
+    assert(scc.condensation.offsets[c + 1] - scc.condensation.offsets[c] == 1);
+    std::vector<int> cycle = ts.findCycle(graph, scc);
+    assert((cycle == std::vector<int>{0, 1, 2}) || (cycle == std::vector<int>{6}) || cycle.size() == 2);
+
+    // Random graphs against reachability computed by brute force
+    std::mt19937 rng(53);
+    for (int round = 0; round < 40; round++) {
+        int n = 1 + rng() % 80;
+        int m = rng() % (2 * n);
+        std::vector<int> from(m), to(m);
+        for (int e = 0; e < m; e++) {
+            from[e] = rng() % n;
+            to[e] = rng() % n;
+        }
+        graph.build(n, from, to);
+        std::vector<std::vector<bool>> reach(n, std::vector<bool>(n));
+        for (int v = 0; v < n; v++) {
+            reach[v][v] = true;
+        }
+        for (int e = 0; e < m; e++) {
+            reach[from[e]][to[e]] = true;
+        }
+        for (int k = 0; k < n; k++) {
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n && reach[i][k]; j++) {
+                    if (reach[k][j]) {
+                        reach[i][j] = true;
+                    }
+                }
+            }
+        }
+        scc = ts.stronglyConnectedComponents(graph);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                assert((scc.component[i] == scc.component[j]) == (reach[i][j] && reach[j][i]));
+            }
+        }
+        // Every edge goes forward in the condensation and is in it exactly once
+        std::vector<std::vector<int>> expected(scc.numComponents);
+        for (int e = 0; e < m; e++) {
+            int a = scc.component[from[e]];
+            int b = scc.component[to[e]];
+            assert(a <= b);
+            if (a != b) {
+                expected[a].push_back(b);
+            }
+        }
+        assert(scc.condensation.numNodes() == scc.numComponents);
+        for (int a = 0; a < scc.numComponents; a++) {
+            std::sort(expected[a].begin(), expected[a].end());
+            expected[a].erase(std::unique(expected[a].begin(), expected[a].end()), expected[a].end());
+            std::vector<int> actual(scc.condensation.targets.begin() + scc.condensation.offsets[a],
+                                    scc.condensation.targets.begin() + scc.condensation.offsets[a + 1]);
+            std::sort(actual.begin(), actual.end());
+            assert(actual == expected[a]);
+            for (int i = scc.members.offsets[a]; i < scc.members.offsets[a + 1]; i++) {
+                assert(scc.component[scc.members.targets[i]] == a);
+            }
+        }
+        // A cycle exists exactly when topsort fails, and the one reported is real
+        std::vector<int> cycle = ts.findCycle(graph, scc);
+        assert(cycle.empty() == !ts.topsort(n, from, to).empty() || n == 0);
+        for (size_t i = 0; i < cycle.size(); i++) {
+            int a = cycle[i];
+            int b = cycle[(i + 1) % cycle.size()];
+            bool edge = false;
+            for (int e = graph.offsets[a]; e < graph.offsets[a + 1]; e++) {
+                edge = edge || graph.targets[e] == b;
+            }
+            assert(edge);
+        }
+    }
+
+    // A ten million node cycle, far deeper than a recursive search could go
+    const int n = 10000000;
+    std::vector<int> from(n), to(n);
+    for (int v = 0; v < n; v++) {
+        from[v] = v;
+        to[v] = (v + 1) % n;
+    }
+    graph.build(n, from, to);
+    scc = ts.stronglyConnectedComponents(graph);
+    assert(scc.numComponents == 1);
+    assert((int)ts.findCycle(graph, scc).size() == n);
+    std::cout << "test_strongly_connected_components passed.\n";
+}
+
+int main() {
+    test_small_graphs();
+    test_csr_build();
+    test_matches_adjacency_version();
+    test_dynamic_order();
+    test_parallel_topsort();
+    test_dag_executor();
+    test_strongly_connected_components();
+
+    std::cout << "All tests passed successfully.\n";
+    return 0;
+}
@@ -1,72 +1,833 @@
+/*
+Trie over 'a'..'z' stored in a contiguous node arena.
+
+Layout:
+- nodes: one 8 byte record per node, addressed by uint32_t index (root is 0).
+  The low NUM_CHARS bits of `children` say which letters have a child, END_BIT marks a word.
+- edges: the child indices of a node, packed in letter order at edges[firstChild...].
+  The child for letter c sits at rank popcount(children & ((1 << c) - 1)).
+- Adding a child moves the node's packed block to a block one larger, removing one moves
+  it to a block one smaller. Freed blocks go on a free list per block size and are reused
+  by later inserts, as are the records of nodes that remove() unlinks.
+
+Autocomplete (WeightedTrie only, Trie keeps just the two arrays above):
+- every word has a weight, and every node caches the TOP_K best words below it
+  (as end nodes, best first), so completions(prefix, k) for k <= TOP_K reads one cache.
+- inserting or reweighting a word only revisits the caches on its own path.
+- parents/letters rebuild a word from its end node.
+- the per-node arrays take 25 bytes a node on top of the 12 of the arena.
+
+Image:
+- save(path) freezes the trie into a flat file that MappedTrie maps and queries in place.
+  The file is a TrieImageHeader followed by one TrieImageNode per node, in native byte order.
+- nodes are renumbered breadth-first, so the children of a node are consecutive records and
+  firstChild is the index of the first one: no edges array, no free blocks, no pointers.
+- weights and completion caches are not part of the image.
+
+ConcurrentTrie:
+- a pointer-per-letter variant for many reader threads and a few inserters.
+  Readers never lock or write shared memory; see the class comment for the protocol.
+*/
 #include <vector>
 #include <iostream>
 #include <string>
 #include <memory>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 constexpr int NUM_CHARS = 26;
+// Number of best completions cached at every node
+constexpr int TOP_K = 4;
+
+// "TRIEIMG1" read as a native integer. A file written on a machine of the
+// other byte order fails the magic check instead of being misread.
+constexpr uint64_t TRIE_IMAGE_MAGIC = 0x31474d4945495254ULL;
+// Bump when the layout of the header or the node records changes
+constexpr uint32_t TRIE_IMAGE_VERSION = 1;
+
+struct TrieImageHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t numChars;
+    uint64_t nodeCount;
+    // FNV-1a of the node records
+    uint64_t checksum;
+};
+// Same bits as a Trie node, except that firstChild indexes the node records
+struct TrieImageNode {
+    uint32_t children;
+    uint32_t firstChild;
+};
+
+inline uint64_t fnv1a(const void* data, size_t length) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
 
-class Node {
-    friend class Trie;
+template<bool Weighted>
+class BasicTrie {
 private:
-    bool isEnd;
-    std::vector<std::unique_ptr<Node>> next;
-public:
-    Node() : isEnd(false), next(NUM_CHARS) {}
-    std::unique_ptr<Node>& getNext(char c) {
+    struct Node {
+        uint32_t children;
+        uint32_t firstChild;
+    };
+    static constexpr uint32_t END_BIT = 1u << 31;
+    static constexpr uint32_t CHILD_MASK = (1u << NUM_CHARS) - 1;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> edges;
+    // Per node, when Weighted: parent, letter of the edge into it, word weight, best words below it.
+    // Left empty otherwise.
+    std::vector<uint32_t> parents;
+    std::vector<uint8_t> letters;
+    std::vector<uint32_t> weights;
+    std::vector<std::array<uint32_t, TOP_K>> topK;
+    // freeBlocks[k] heads a list of released edge blocks of size k,
+    // linked through their first entry
+    std::array<uint32_t, NUM_CHARS + 1> freeBlocks;
+    // Head of the unlinked node records, linked through firstChild
+    uint32_t freeNodes = NONE;
+    size_t numFreeNodes = 0;
+
+    static uint32_t charIndex(char c) {
         size_t index = c - 'a';
         if (index >= NUM_CHARS) {
             throw std::invalid_argument(std::format("Invalid character {}, index={}", c, index));
         }
-        return next[index];
+        return static_cast<uint32_t>(index);
     }
-    void createIfNotExist(char c) {
-        size_t index = c - 'a';
-        if (index >= NUM_CHARS) {
-            throw std::invalid_argument(std::format("Invalid character {}, index={}", c, index));
+    // Returns the child of node for letter c, or NONE
+    uint32_t getNext(uint32_t node, uint32_t c) const {
+        uint32_t bit = 1u << c;
+        const Node& n = nodes[node];
+        if (!(n.children & bit)) {
+            return NONE;
         }
-        if (!next[index]) {
-            next[index] = std::make_unique<Node>();
+        return edges[n.firstChild + std::popcount(n.children & (bit - 1))];
+    }
+    uint32_t allocBlock(uint32_t size) {
+        uint32_t block = freeBlocks[size];
+        if (block != NONE) {
+            freeBlocks[size] = edges[block];
+            return block;
         }
+        block = static_cast<uint32_t>(edges.size());
+        edges.resize(edges.size() + size);
+        return block;
+    }
+    void freeBlock(uint32_t block, uint32_t size) {
+        if (size == 0) {
+            return;
+        }
+        edges[block] = freeBlocks[size];
+        freeBlocks[size] = block;
+    }
+    // Returns the child of node for letter c, creating it if it does not exist
+    uint32_t createIfNotExist(uint32_t node, uint32_t c) {
+        uint32_t child = getNext(node, c);
+        if (child != NONE) {
+            return child;
+        }
+        if (freeNodes != NONE) {
+            child = freeNodes;
+            freeNodes = nodes[child].firstChild;
+            numFreeNodes--;
+            nodes[child] = {0, 0};
+            if constexpr (Weighted) {
+                parents[child] = node;
+                letters[child] = static_cast<uint8_t>(c);
+                weights[child] = 0;
+                topK[child] = emptyCache();
+            }
+        } else {
+            child = static_cast<uint32_t>(nodes.size());
+            nodes.push_back({0, 0});
+            if constexpr (Weighted) {
+                parents.push_back(node);
+                letters.push_back(static_cast<uint8_t>(c));
+                weights.push_back(0);
+                topK.push_back(emptyCache());
+            }
+        }
+        // Copy into a block one larger, leaving a gap at the new child's rank
+        uint32_t children = nodes[node].children & CHILD_MASK;
+        uint32_t count = std::popcount(children);
+        uint32_t rank = std::popcount(children & ((1u << c) - 1));
+        uint32_t oldBlock = nodes[node].firstChild;
+        uint32_t newBlock = allocBlock(count + 1);
+        for (uint32_t i = 0; i < rank; i++) {
+            edges[newBlock + i] = edges[oldBlock + i];
+        }
+        edges[newBlock + rank] = child;
+        for (uint32_t i = rank; i < count; i++) {
+            edges[newBlock + i + 1] = edges[oldBlock + i];
+        }
+        freeBlock(oldBlock, count);
+        nodes[node].firstChild = newBlock;
+        nodes[node].children |= 1u << c;
+        return child;
+    }
+    // Unlinks the child of node for letter c and puts its record on the free list
+    void removeChild(uint32_t node, uint32_t c) {
+        uint32_t children = nodes[node].children & CHILD_MASK;
+        uint32_t count = std::popcount(children);
+        uint32_t rank = std::popcount(children & ((1u << c) - 1));
+        uint32_t oldBlock = nodes[node].firstChild;
+        uint32_t child = edges[oldBlock + rank];
+        uint32_t newBlock = (count > 1) ? allocBlock(count - 1) : 0;
+        for (uint32_t i = 0; i < rank; i++) {
+            edges[newBlock + i] = edges[oldBlock + i];
+        }
+        for (uint32_t i = rank + 1; i < count; i++) {
+            edges[newBlock + i - 1] = edges[oldBlock + i];
+        }
+        freeBlock(oldBlock, count);
+        nodes[node].firstChild = newBlock;
+        nodes[node].children &= ~(1u << c);
+        nodes[child] = {0, freeNodes};
+        freeNodes = child;
+        numFreeNodes++;
+    }
+    // Throws on the first character outside 'a'..'z', before anything is changed
+    static void checkWord(const std::string& word) {
+        for (char c : word) {
+            charIndex(c);
+        }
+    }
+    static std::array<uint32_t, TOP_K> emptyCache() {
+        std::array<uint32_t, TOP_K> cache;
+        cache.fill(NONE);
+        return cache;
+    }
+    bool isEnd(uint32_t node) const {
+        return nodes[node].children & END_BIT;
+    }
+    // Total order on words: heavier first, ties broken by the lower node index
+    bool better(uint32_t a, uint32_t b) const {
+        if (b == NONE) {
+            return a != NONE;
+        }
+        return a != NONE && (weights[a] > weights[b] || (weights[a] == weights[b] && a < b));
+    }
+    // Offers word (an end node) to node's cache. Returns false if it did not make the cut,
+    // in which case no ancestor's cache can take it either.
+    bool offer(uint32_t node, uint32_t word) {
+        std::array<uint32_t, TOP_K>& cache = topK[node];
+        int pos = 0;
+        while (pos < TOP_K && cache[pos] != word) {
+            pos++;
+        }
+        if (pos == TOP_K) {
+            if (!better(word, cache[TOP_K - 1])) {
+                return false;
+            }
+            pos = TOP_K - 1;
+        }
+        // Bubble the (new or heavier) word up to its place
+        cache[pos] = word;
+        while (pos > 0 && better(cache[pos], cache[pos - 1])) {
+            std::swap(cache[pos], cache[pos - 1]);
+            pos--;
+        }
+        return true;
+    }
+    // Rebuilds node's cache from its own word and its children's caches
+    void recompute(uint32_t node) {
+        std::array<uint32_t, TOP_K> cache = emptyCache();
+        auto consider = [&](uint32_t word) {
+            if (!better(word, cache[TOP_K - 1])) {
+                return;
+            }
+            int pos = TOP_K - 1;
+            cache[pos] = word;
+            while (pos > 0 && better(cache[pos], cache[pos - 1])) {
+                std::swap(cache[pos], cache[pos - 1]);
+                pos--;
+            }
+        };
+        if (isEnd(node)) {
+            consider(node);
+        }
+        const Node& n = nodes[node];
+        for (int i = 0, count = std::popcount(n.children & CHILD_MASK); i < count; i++) {
+            for (uint32_t word : topK[edges[n.firstChild + i]]) {
+                consider(word);
+            }
+        }
+        topK[node] = cache;
+    }
+    // Brings the caches on the path of word (an end node) up to date after its
+    // weight changed from oldWeight
+    void updateCaches(uint32_t word, uint32_t oldWeight) {
+        bool heavier = weights[word] >= oldWeight;
+        for (uint32_t node = word; ; node = parents[node]) {
+            if (heavier) {
+                if (!offer(node, word)) {
+                    break;
+                }
+            } else {
+                // A lighter word can only drop out of caches that held it
+                if (std::find(topK[node].begin(), topK[node].end(), word) == topK[node].end()) {
+                    break;
+                }
+                recompute(node);
+            }
+            if (node == 0) {
+                break;
+            }
+        }
+    }
+    // Rebuilds the word ending at node by walking up to the root
+    std::string wordAt(uint32_t node) const {
+        std::string word;
+        for (; node != 0; node = parents[node]) {
+            word.push_back(static_cast<char>('a' + letters[node]));
+        }
+        return std::string(word.rbegin(), word.rend());
+    }
+    // Returns the node reached by following prefix, or NONE
+    uint32_t walk(const std::string& prefix) const {
+        uint32_t curr = 0;
+        for (char c : prefix) {
+            curr = getNext(curr, charIndex(c));
+            if (curr == NONE) {
+                return NONE;
+            }
+        }
+        return curr;
     }
-};
-
-class Trie {
-private:
-    std::unique_ptr<Node> root;
 public:
-    Trie() : root(std::make_unique<Node>()) {}
+    // Streams the words below a prefix in lexicographic order, one node step at a
+    // time, without collecting them first. Holds a stack as deep as the longest word.
+    class PrefixIterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::string;
+        using difference_type = std::ptrdiff_t;
+
+        PrefixIterator() = default;
+        PrefixIterator(const BasicTrie* trie, uint32_t start, const std::string& prefix) : trie(trie), word(prefix) {
+            if (start == NONE) {
+                return;
+            }
+            stack.push_back({start, trie->nodes[start].children & CHILD_MASK});
+            if (!trie->isEnd(start)) {
+                advance();
+            }
+        }
+        const std::string& operator*() const {
+            return word;
+        }
+        PrefixIterator& operator++() {
+            advance();
+            return *this;
+        }
+        void operator++(int) {
+            advance();
+        }
+        friend bool operator==(const PrefixIterator& it, std::default_sentinel_t) {
+            return it.stack.empty();
+        }
+    private:
+        const BasicTrie* trie = nullptr;
+        std::string word;
+        // (node, letters of its children not visited yet)
+        std::vector<std::pair<uint32_t, uint32_t>> stack;
+
+        // Pre-order step to the next end node
+        void advance() {
+            while (!stack.empty()) {
+                auto& [node, remaining] = stack.back();
+                if (remaining == 0) {
+                    stack.pop_back();
+                    if (!stack.empty()) {
+                        word.pop_back();
+                    }
+                    continue;
+                }
+                uint32_t c = std::countr_zero(remaining);
+                remaining &= remaining - 1;
+                uint32_t child = trie->getNext(node, c);
+                word.push_back(static_cast<char>('a' + c));
+                stack.push_back({child, trie->nodes[child].children & CHILD_MASK});
+                if (trie->isEnd(child)) {
+                    return;
+                }
+            }
+        }
+    };
+    struct PrefixRange {
+        PrefixIterator first;
+        PrefixIterator begin() const { return first; }
+        std::default_sentinel_t end() const { return {}; }
+    };
+
+    BasicTrie() : nodes(1, Node{0, 0}) {
+        if constexpr (Weighted) {
+            parents.assign(1, NONE);
+            letters.assign(1, 0);
+            weights.assign(1, 0);
+            topK.assign(1, emptyCache());
+        }
+        freeBlocks.fill(NONE);
+    }
+    // Pre-sizes the arena for about numNodes nodes
+    void reserve(size_t numNodes) {
+        nodes.reserve(numNodes);
+        edges.reserve(numNodes);
+        if constexpr (Weighted) {
+            parents.reserve(numNodes);
+            letters.reserve(numNodes);
+            weights.reserve(numNodes);
+            topK.reserve(numNodes);
+        }
+    }
+    // Adds word with weight 0, keeping the weight of a word that is already present
     void insert(const std::string& word) {
-        Node *curr = root.get();
+        checkWord(word);
+        uint32_t curr = 0;
         for (char c : word) {
-            curr->createIfNotExist(c);
-            curr = curr->getNext(c).get();
+            curr = createIfNotExist(curr, charIndex(c));
+        }
+        if (!isEnd(curr)) {
+            nodes[curr].children |= END_BIT;
+            if constexpr (Weighted) {
+                updateCaches(curr, 0);
+            }
         }
-        curr->isEnd = true;
     }
-    bool search(const std::string& word) {
-        Node *curr = root.get();
+    // Adds word or changes its weight
+    void insert(const std::string& word, uint32_t weight) requires Weighted {
+        checkWord(word);
+        uint32_t curr = 0;
         for (char c : word) {
-            curr = curr->getNext(c).get();
-            if (!curr) {
+            curr = createIfNotExist(curr, charIndex(c));
+        }
+        uint32_t oldWeight = isEnd(curr) ? weights[curr] : 0;
+        nodes[curr].children |= END_BIT;
+        weights[curr] = weight;
+        updateCaches(curr, oldWeight);
+    }
+    // Removes word and unlinks the nodes left on no word's path.
+    // Returns false if word was not present.
+    bool remove(const std::string& word) {
+        std::vector<uint32_t> path = {0};
+        path.reserve(word.size() + 1);
+        for (char c : word) {
+            uint32_t next = getNext(path.back(), charIndex(c));
+            if (next == NONE) {
                 return false;
             }
+            path.push_back(next);
+        }
+        uint32_t end = path.back();
+        if (!isEnd(end)) {
+            return false;
+        }
+        nodes[end].children &= ~END_BIT;
+        size_t depth = word.size();
+        while (depth > 0 && nodes[path[depth]].children == 0) {
+            removeChild(path[depth - 1], charIndex(word[depth - 1]));
+            depth--;
+        }
+        if constexpr (Weighted) {
+            weights[end] = 0;
+            // Caches below the lowest kept node were unlinked with their nodes. Above it,
+            // only the caches that held the word change, and those form a chain up from it.
+            for (size_t i = depth + 1; i-- > 0;) {
+                uint32_t node = path[i];
+                if (std::find(topK[node].begin(), topK[node].end(), end) == topK[node].end()) {
+                    break;
+                }
+                recompute(node);
+            }
         }
-        return curr->isEnd;
+        return true;
     }
-    
-    bool startsWith(const std::string& prefix) {
-        Node *curr = root.get();
+    bool search(const std::string& word) const {
+        uint32_t curr = walk(word);
+        return curr != NONE && (nodes[curr].children & END_BIT);
+    }
+    bool startsWith(const std::string& prefix) const {
+        uint32_t curr = walk(prefix);
+        // Any node but an empty root lies on the path of some word
+        return curr != NONE && nodes[curr].children != 0;
+    }
+    // Returns the weight of word, or 0 if it is absent
+    uint32_t weight(const std::string& word) const requires Weighted {
+        uint32_t curr = walk(word);
+        return (curr != NONE && isEnd(curr)) ? weights[curr] : 0;
+    }
+    // Returns the k heaviest words starting with prefix, heaviest first.
+    // Up to TOP_K comes straight from the prefix node's cache. Beyond that a best-first
+    // search expands subtrees in order of their best cached word, so it only
+    // visits about k nodes' children rather than the whole subtree.
+    std::vector<std::string> completions(const std::string& prefix, size_t k) const requires Weighted {
+        std::vector<std::string> result;
+        uint32_t start = walk(prefix);
+        if (start == NONE || k == 0) {
+            return result;
+        }
+        if (k <= TOP_K) {
+            for (size_t i = 0; i < k && topK[start][i] != NONE; i++) {
+                result.push_back(wordAt(topK[start][i]));
+            }
+            return result;
+        }
+        // Entries are (best word, node, whether the entry is the word itself or its subtree)
+        struct Entry {
+            uint32_t best;
+            uint32_t node;
+            bool isWord;
+        };
+        auto worse = [this](const Entry& a, const Entry& b) {
+            return better(b.best, a.best) || (a.best == b.best && !a.isWord && b.isWord);
+        };
+        std::priority_queue<Entry, std::vector<Entry>, decltype(worse)> pq(worse);
+        if (topK[start][0] != NONE) {
+            pq.push({topK[start][0], start, false});
+        }
+        while (!pq.empty() && result.size() < k) {
+            Entry e = pq.top();
+            pq.pop();
+            if (e.isWord) {
+                result.push_back(wordAt(e.node));
+                continue;
+            }
+            if (isEnd(e.node)) {
+                pq.push({e.node, e.node, true});
+            }
+            const Node& n = nodes[e.node];
+            for (int i = 0, count = std::popcount(n.children & CHILD_MASK); i < count; i++) {
+                uint32_t child = edges[n.firstChild + i];
+                if (topK[child][0] != NONE) {
+                    pq.push({topK[child][0], child, false});
+                }
+            }
+        }
+        return result;
+    }
+    // Lazily iterates over every word starting with prefix in lexicographic order:
+    //   for (const std::string& w : trie.prefixRange("ca")) { ... }
+    PrefixRange prefixRange(const std::string& prefix) const {
+        return {PrefixIterator(this, walk(prefix), prefix)};
+    }
+    // Writes the trie as an image for MappedTrie. The image goes to a temporary file that is
+    // renamed over path, so processes mapping an older image at path keep a consistent view.
+    void save(const std::string& path) const {
+        std::vector<TrieImageNode> image;
+        image.reserve(nodes.size());
+        // order[i] is the node that becomes record i. Visiting breadth-first appends
+        // the children of record i right after each other, starting at order.size().
+        std::vector<uint32_t> order = {0};
+        order.reserve(nodes.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            const Node& n = nodes[order[i]];
+            image.push_back({n.children, static_cast<uint32_t>(order.size())});
+            for (int j = 0, count = std::popcount(n.children & CHILD_MASK); j < count; j++) {
+                order.push_back(edges[n.firstChild + j]);
+            }
+        }
+        TrieImageHeader header{TRIE_IMAGE_MAGIC, TRIE_IMAGE_VERSION, NUM_CHARS, image.size(),
+            fnv1a(image.data(), image.size() * sizeof(TrieImageNode))};
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(image.data()), image.size() * sizeof(TrieImageNode));
+            out.flush();
+            if (!out) {
+                throw std::runtime_error("Cannot write trie image " + tmp);
+            }
+        }
+        std::filesystem::rename(tmp, path);
+    }
+    // Nodes in use, not counting records freed by remove()
+    size_t nodeCount() const {
+        return nodes.size() - numFreeNodes;
+    }
+    // Bytes held by the arena and per-node arrays, including free blocks and spare capacity
+    size_t memoryUsage() const {
+        return nodes.capacity() * sizeof(Node) + edges.capacity() * sizeof(uint32_t)
+            + parents.capacity() * sizeof(uint32_t) + letters.capacity()
+            + weights.capacity() * sizeof(uint32_t) + topK.capacity() * sizeof(topK[0]);
+    }
+};
+
+// Set of words: 8 bytes per node plus its slot in edges
+using Trie = BasicTrie<false>;
+// Adds weights and completions, for autocomplete
+using WeightedTrie = BasicTrie<true>;
+
+// Read-only Trie over an image written by Trie::save, queried straight from a
+// shared read-only mapping. Opening costs a few system calls plus, when verify is
+// set, one pass over the file. Processes mapping the same image share its pages.
+class MappedTrie {
+private:
+    static constexpr uint32_t END_BIT = 1u << 31;
+    static constexpr uint32_t CHILD_MASK = (1u << NUM_CHARS) - 1;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    void* base = nullptr;
+    size_t length = 0;
+    const TrieImageNode* nodes = nullptr;
+    size_t count = 0;
+
+    static uint32_t charIndex(char c) {
+        size_t index = c - 'a';
+        if (index >= NUM_CHARS) {
+            throw std::invalid_argument(std::format("Invalid character {}, index={}", c, index));
+        }
+        return static_cast<uint32_t>(index);
+    }
+    // Checks the header and, if verify is set, the checksum and that every child
+    // block lies inside the file. Throws std::runtime_error on a bad image.
+    void validate(const std::string& path, bool verify) const {
+        if (length < sizeof(TrieImageHeader)) {
+            throw std::runtime_error("Truncated trie image " + path);
+        }
+        TrieImageHeader header;
+        std::memcpy(&header, base, sizeof(header));
+        if (header.magic != TRIE_IMAGE_MAGIC) {
+            throw std::runtime_error("Not a trie image (or written with another byte order) " + path);
+        }
+        if (header.version != TRIE_IMAGE_VERSION || header.numChars != NUM_CHARS) {
+            throw std::runtime_error(std::format("Unsupported trie image version {} ({} letters) {}",
+                header.version, header.numChars, path));
+        }
+        if (header.nodeCount == 0 || header.nodeCount > NONE
+            || length != sizeof(TrieImageHeader) + header.nodeCount * sizeof(TrieImageNode)) {
+            throw std::runtime_error("Trie image size does not match its header " + path);
+        }
+        if (!verify) {
+            return;
+        }
+        const TrieImageNode* records = reinterpret_cast<const TrieImageNode*>(
+            static_cast<const char*>(base) + sizeof(TrieImageHeader));
+        if (fnv1a(records, header.nodeCount * sizeof(TrieImageNode)) != header.checksum) {
+            throw std::runtime_error("Trie image checksum mismatch " + path);
+        }
+        for (size_t i = 0; i < header.nodeCount; i++) {
+            uint64_t end = uint64_t(records[i].firstChild) + std::popcount(records[i].children & CHILD_MASK);
+            if (end > header.nodeCount) {
+                throw std::runtime_error("Trie image has a child out of range " + path);
+            }
+        }
+    }
+    // Returns the record reached by following prefix, or NONE
+    uint32_t walk(const std::string& prefix) const {
+        uint32_t curr = 0;
         for (char c : prefix) {
-            curr = curr->getNext(c).get();
+            uint32_t bit = 1u << charIndex(c);
+            const TrieImageNode& n = nodes[curr];
+            if (!(n.children & bit)) {
+                return NONE;
+            }
+            curr = n.firstChild + std::popcount(n.children & (bit - 1));
+        }
+        return curr;
+    }
+public:
+    explicit MappedTrie(const std::string& path, bool verify = true) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), "Cannot stat " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        void* mapped = length ? ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        int err = errno;
+        // The mapping stays valid after the descriptor is closed
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            length = 0;
+            if (st.st_size == 0) {
+                throw std::runtime_error("Truncated trie image " + path);
+            }
+            throw std::system_error(err, std::generic_category(), "Cannot map " + path);
+        }
+        base = mapped;
+        try {
+            validate(path, verify);
+        } catch (...) {
+            ::munmap(base, length);
+            throw;
+        }
+        nodes = reinterpret_cast<const TrieImageNode*>(static_cast<const char*>(base) + sizeof(TrieImageHeader));
+        count = (length - sizeof(TrieImageHeader)) / sizeof(TrieImageNode);
+    }
+    MappedTrie(const MappedTrie&) = delete;
+    MappedTrie& operator=(const MappedTrie&) = delete;
+    MappedTrie(MappedTrie&& other) noexcept
+        : base(std::exchange(other.base, nullptr)), length(std::exchange(other.length, 0)),
+          nodes(std::exchange(other.nodes, nullptr)), count(std::exchange(other.count, 0)) {}
+    MappedTrie& operator=(MappedTrie&& other) noexcept {
+        if (this != &other) {
+            if (base) {
+                ::munmap(base, length);
+            }
+            base = std::exchange(other.base, nullptr);
+            length = std::exchange(other.length, 0);
+            nodes = std::exchange(other.nodes, nullptr);
+            count = std::exchange(other.count, 0);
+        }
+        return *this;
+    }
+    ~MappedTrie() {
+        if (base) {
+            ::munmap(base, length);
+        }
+    }
+    bool search(const std::string& word) const {
+        uint32_t curr = walk(word);
+        return curr != NONE && (nodes[curr].children & END_BIT);
+    }
+    bool startsWith(const std::string& prefix) const {
+        uint32_t curr = walk(prefix);
+        return curr != NONE && nodes[curr].children != 0;
+    }
+    size_t nodeCount() const {
+        return count;
+    }
+};
+
+// Trie that many threads can query while others insert.
+// - search/startsWith only do acquire loads: no locks, no shared writes.
+// - a missing child is created off to the side and published with a release CAS on
+//   the parent's slot. The loser of a race deletes its node and follows the winner's.
+// - an inserter sets the word's end flag, then hasWords on every node of its path from
+//   the root down. Readers need hasWords, so neither search nor startsWith reports a
+//   word (or a prefix of it) before its insert has set the end flag.
+// Words are never removed and nodes are never unlinked, so a reader can not reach
+// freed memory and no epoch or hazard pointer scheme is needed. Nodes are freed
+// with the trie, which must outlive every thread using it.
+class ConcurrentTrie {
+private:
+    struct Node {
+        std::atomic<Node*> next[NUM_CHARS] = {};
+        std::atomic<bool> isEnd = false;
+        std::atomic<bool> hasWords = false;
+    };
+    Node root;
+    std::atomic<size_t> nodes = 1;
+
+    static uint32_t charIndex(char c) {
+        size_t index = c - 'a';
+        if (index >= NUM_CHARS) {
+            throw std::invalid_argument(std::format("Invalid character {}, index={}", c, index));
+        }
+        return static_cast<uint32_t>(index);
+    }
+    const Node* walk(const std::string& prefix) const {
+        const Node* curr = &root;
+        for (char c : prefix) {
+            curr = curr->next[charIndex(c)].load(std::memory_order_acquire);
             if (!curr) {
-                return false;
+                return nullptr;
             }
         }
-        bool hasNext = std::any_of(curr->next.begin(), curr->next.end(), 
-            [](const std::unique_ptr<Node>& ptr){
-                return ptr != nullptr;
+        return curr;
+    }
+public:
+    ConcurrentTrie() = default;
+    ConcurrentTrie(const ConcurrentTrie&) = delete;
+    ConcurrentTrie& operator=(const ConcurrentTrie&) = delete;
+    ~ConcurrentTrie() {
+        std::vector<Node*> stack;
+        for (auto& child : root.next) {
+            if (Node* n = child.load(std::memory_order_relaxed)) {
+                stack.push_back(n);
             }
-        );
-        return (curr->isEnd || hasNext);
+        }
+        while (!stack.empty()) {
+            Node* n = stack.back();
+            stack.pop_back();
+            for (auto& child : n->next) {
+                if (Node* c = child.load(std::memory_order_relaxed)) {
+                    stack.push_back(c);
+                }
+            }
+            delete n;
+        }
     }
-};
\ No newline at end of file
+    // Adds word. Returns false if it was already present. Safe to call from any thread.
+    bool insert(const std::string& word) {
+        // Check every letter first, so that a bad word leaves no nodes behind
+        for (char c : word) {
+            charIndex(c);
+        }
+        Node* curr = &root;
+        Node* spare = nullptr;
+        for (char c : word) {
+            std::atomic<Node*>& slot = curr->next[c - 'a'];
+            Node* child = slot.load(std::memory_order_acquire);
+            if (!child) {
+                if (!spare) {
+                    spare = new Node();
+                }
+                // On failure child is the node another inserter published
+                if (slot.compare_exchange_strong(child, spare, std::memory_order_release, std::memory_order_acquire)) {
+                    child = std::exchange(spare, nullptr);
+                    nodes.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            curr = child;
+        }
+        delete spare;
+        bool added = !curr->isEnd.exchange(true, std::memory_order_release);
+        // Program order puts the end flag before these release stores, so a reader that sees
+        // hasWords on a node of the path also sees the word. Going root first keeps hasWords
+        // on a node implying hasWords on its parent. A duplicate runs the pass too, in case
+        // the first inserter of the word has not finished it yet.
+        Node* n = &root;
+        for (size_t i = 0; ; i++) {
+            if (!n->hasWords.load(std::memory_order_relaxed)) {
+                n->hasWords.store(true, std::memory_order_release);
+            }
+            if (i == word.size()) {
+                break;
+            }
+            n = n->next[word[i] - 'a'].load(std::memory_order_relaxed);
+        }
+        return added;
+    }
+    bool search(const std::string& word) const {
+        const Node* curr = walk(word);
+        // hasWords is set on the end node last, so a word found here is also seen by
+        // startsWith of each of its prefixes
+        return curr && curr->hasWords.load(std::memory_order_acquire) && curr->isEnd.load(std::memory_order_acquire);
+    }
+    bool startsWith(const std::string& prefix) const {
+        const Node* curr = walk(prefix);
+        return curr && curr->hasWords.load(std::memory_order_acquire);
+    }
+    size_t nodeCount() const {
+        return nodes.load(std::memory_order_relaxed);
+    }
+};
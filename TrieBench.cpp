@@ -0,0 +1,293 @@
+// Build-and-query benchmark for Trie, WeightedTrie and RadixTrie.
+// Usage: ./TrieBench [num_words | word_list_file] [max_threads]
+//   defaults to 1000000 random words and 32 threads.
+// Words from a file must be lowercase 'a'..'z', one per line.
+// The concurrent run uses at most CONCURRENT_WORDS of them, as ConcurrentTrie nodes take 216 bytes.
+// Build with -march=native (or at least -mpopcnt): child lookups rank through std::popcount,
+// which is a library call without the popcnt instruction.
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Trie.cpp"
+#include "RadixTrie.cpp"
+
+// Counts live heap bytes so that both tries are measured the same way
+static std::atomic<size_t> liveBytes = 0;
+
+void* operator new(size_t size) {
+    void* p = std::malloc(size + sizeof(size_t));
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    *static_cast<size_t*>(p) = size;
+    liveBytes += size;
+    return static_cast<size_t*>(p) + 1;
+}
+void operator delete(void* p) noexcept {
+    if (!p) {
+        return;
+    }
+    size_t* base = static_cast<size_t*>(p) - 1;
+    liveBytes -= *base;
+    std::free(base);
+}
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+// The previous pointer-per-child layout, kept as the baseline
+class PointerTrie {
+private:
+    struct Node {
+        bool isEnd = false;
+        std::vector<std::unique_ptr<Node>> next = std::vector<std::unique_ptr<Node>>(NUM_CHARS);
+    };
+    std::unique_ptr<Node> root = std::make_unique<Node>();
+public:
+    void insert(const std::string& word) {
+        Node* curr = root.get();
+        for (char c : word) {
+            auto& next = curr->next[c - 'a'];
+            if (!next) {
+                next = std::make_unique<Node>();
+            }
+            curr = next.get();
+        }
+        curr->isEnd = true;
+    }
+    const Node* walk(const std::string& prefix) const {
+        const Node* curr = root.get();
+        for (char c : prefix) {
+            curr = curr->next[c - 'a'].get();
+            if (!curr) {
+                return nullptr;
+            }
+        }
+        return curr;
+    }
+    bool search(const std::string& word) const {
+        const Node* curr = walk(word);
+        return curr && curr->isEnd;
+    }
+    bool startsWith(const std::string& prefix) const {
+        const Node* curr = walk(prefix);
+        return curr && (curr->isEnd || std::any_of(curr->next.begin(), curr->next.end(),
+            [](const std::unique_ptr<Node>& ptr) { return ptr != nullptr; }));
+    }
+};
+
+template<typename Fn>
+double timeMs(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+volatile size_t sink;
+
+// build returns a heap-allocated trie holding words
+template<typename T, typename Build>
+void run(const std::string& name, Build build, const std::vector<std::string>& queries) {
+    size_t before = liveBytes;
+    T* trie = nullptr;
+    double buildMs = timeMs([&] {
+        trie = build();
+    });
+    size_t bytes = liveBytes - before;
+    double searchMs = timeMs([&] {
+        size_t found = 0;
+        for (const std::string& q : queries) {
+            found += trie->search(q);
+        }
+        sink = found;
+    });
+    double prefixMs = timeMs([&] {
+        size_t found = 0;
+        for (const std::string& q : queries) {
+            found += trie->startsWith(q.substr(0, (q.size() + 1) / 2));
+        }
+        sink = found;
+    });
+    std::cout << std::format("  {:<16} build {:8.1f} ms  memory {:8.1f} MiB  search {:7.1f} ns  startsWith {:7.1f} ns\n",
+        name, buildMs, bytes / 1048576.0, searchMs * 1e6 / queries.size(), prefixMs * 1e6 / queries.size());
+    delete trie;
+}
+
+// Weighted autocomplete: cached top-k, best-first top-k beyond the cache,
+// and the first few words of a lazily iterated prefix range
+void runCompletions(const std::vector<std::string>& words, const std::vector<std::string>& queries) {
+    WeightedTrie trie;
+    std::mt19937 rng(11);
+    double buildMs = timeMs([&] {
+        for (const std::string& w : words) {
+            trie.insert(w, static_cast<uint32_t>(rng() % 1000000));
+        }
+    });
+    std::vector<std::string> prefixes;
+    for (const std::string& q : queries) {
+        prefixes.push_back(q.substr(0, 2));
+    }
+    auto perQuery = [&](size_t k) {
+        return timeMs([&] {
+            size_t total = 0;
+            for (const std::string& p : prefixes) {
+                total += trie.completions(p, k).size();
+            }
+            sink = total;
+        }) * 1e6 / prefixes.size();
+    };
+    double cachedNs = perQuery(TOP_K);
+    double searchNs = perQuery(20);
+    double iterNs = timeMs([&] {
+        size_t total = 0;
+        for (const std::string& p : prefixes) {
+            size_t taken = 0;
+            for (const std::string& w : trie.prefixRange(p)) {
+                total += w.size();
+                if (++taken == 10) {
+                    break;
+                }
+            }
+        }
+        sink = total;
+    }) * 1e6 / prefixes.size();
+    std::cout << std::format("  weighted build {:8.1f} ms  completions(k={}) {:7.1f} ns  completions(k=20) {:7.1f} ns  first 10 of prefixRange {:7.1f} ns\n",
+        buildMs, TOP_K, cachedNs, searchNs, iterNs);
+}
+
+// Trie behind a reader-writer lock, the baseline for ConcurrentTrie
+class LockedTrie {
+private:
+    Trie trie;
+    mutable std::shared_mutex mutex;
+public:
+    void insert(const std::string& word) {
+        std::unique_lock lock(mutex);
+        trie.insert(word);
+    }
+    bool search(const std::string& word) const {
+        std::shared_lock lock(mutex);
+        return trie.search(word);
+    }
+};
+
+constexpr size_t CONCURRENT_WORDS = 200000;
+
+// Reader threads search while one writer inserts the second half of the words and then
+// keeps inserting fresh ones until the readers finish. Reports aggregate read throughput.
+template<typename T>
+void runConcurrent(const std::string& name, const std::vector<std::string>& words,
+                   const std::vector<std::string>& queries, size_t maxThreads) {
+    constexpr size_t OPS_PER_THREAD = 1000000;
+    std::cout << std::format("  {}\n", name);
+    double baseline = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        T trie;
+        for (size_t i = 0; i < words.size() / 2; i++) {
+            trie.insert(words[i]);
+        }
+        std::atomic<bool> done = false;
+        size_t written = 0;
+        std::thread writer([&] {
+            std::mt19937 rng(3);
+            for (size_t i = words.size() / 2; !done.load(std::memory_order_relaxed); i++) {
+                std::string w = (i < words.size()) ? words[i] : words[rng() % words.size()] + "x";
+                trie.insert(w);
+                written++;
+            }
+        });
+        std::vector<std::thread> readers;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < threads; t++) {
+            readers.emplace_back([&, t] {
+                size_t found = 0;
+                for (size_t op = 0, i = t * 7919; op < OPS_PER_THREAD; op++, i++) {
+                    found += trie.search(queries[i % queries.size()]);
+                }
+                sink = found;
+            });
+        }
+        for (std::thread& r : readers) {
+            r.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        done = true;
+        writer.join();
+        double mops = threads * OPS_PER_THREAD / std::chrono::duration<double, std::micro>(end - start).count();
+        if (threads == 1) {
+            baseline = mops;
+        }
+        std::cout << std::format("    readers {:>2}  {:8.2f} Mops/s  speedup {:5.2f}x  writer inserts {}\n",
+            threads, mops, mops / baseline, written);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> words;
+    std::mt19937 rng(7);
+    std::string arg = (argc > 1) ? argv[1] : "1000000";
+    size_t maxThreads = (argc > 2) ? std::stoull(argv[2]) : 32;
+    if (std::all_of(arg.begin(), arg.end(), ::isdigit)) {
+        size_t n = std::stoull(arg);
+        // Skewed letters and lengths give shared prefixes like a real dictionary
+        std::geometric_distribution<int> letter(0.15);
+        std::uniform_int_distribution<int> length(3, 12);
+        for (size_t i = 0; i < n; i++) {
+            std::string w(length(rng), 'a');
+            for (char& c : w) {
+                c = static_cast<char>('a' + letter(rng) % NUM_CHARS);
+            }
+            words.push_back(std::move(w));
+        }
+    } else {
+        std::ifstream in(arg);
+        for (std::string w; std::getline(in, w);) {
+            words.push_back(w);
+        }
+    }
+    // Half the queries hit, half are words with a changed last letter
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < words.size(); i++) {
+        std::string q = words[rng() % words.size()];
+        if (i % 2) {
+            q.back() = static_cast<char>('a' + (q.back() - 'a' + 13) % NUM_CHARS);
+        }
+        queries.push_back(std::move(q));
+    }
+    auto insertAll = [&words]<typename T>() {
+        T* trie = new T();
+        for (const std::string& w : words) {
+            trie->insert(w);
+        }
+        return trie;
+    };
+    // The static RadixTrie build takes sorted keys, sorting is not timed
+    std::vector<std::string> sorted(words);
+    std::sort(sorted.begin(), sorted.end());
+    std::cout << "Trie build and query, " << words.size() << " words\n";
+    run<PointerTrie>("PointerTrie", [&] { return insertAll.operator()<PointerTrie>(); }, queries);
+    run<Trie>("Trie", [&] { return insertAll.operator()<Trie>(); }, queries);
+    run<WeightedTrie>("WeightedTrie", [&] { return insertAll.operator()<WeightedTrie>(); }, queries);
+    run<RadixTrie>("RadixTrie", [&] { return insertAll.operator()<RadixTrie>(); }, queries);
+    run<RadixTrie>("RadixTrie static", [&] { return new RadixTrie(sorted); }, queries);
+    std::cout << "Autocomplete over 2-letter prefixes\n";
+    runCompletions(words, queries);
+    std::vector<std::string> few(words.begin(), words.begin() + std::min(words.size(), CONCURRENT_WORDS));
+    std::vector<std::string> fewQueries(queries.begin(), queries.begin() + few.size());
+    std::cout << "Searches while a writer inserts, " << few.size() << " words\n";
+    runConcurrent<ConcurrentTrie>("ConcurrentTrie", few, fewQueries, maxThreads);
+    runConcurrent<LockedTrie>("Trie + std::shared_mutex", few, fewQueries, maxThreads);
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Converts a word list into a trie image for MappedTrie, and queries images.
+// Usage:
+//   ./TrieImageTool build <word_list> <image>   words are lowercase 'a'..'z', one per line
+//   ./TrieImageTool query <image> [word...]     looks up each word, or each line of stdin
+// build re-opens the image it wrote with full verification before reporting success,
+// query maps it with the header checks only, as a worker process would at startup.
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Trie.cpp"
+
+template<typename Fn>
+double timeMs(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int build(const std::string& wordList, const std::string& imagePath) {
+    std::ifstream in(wordList);
+    if (!in) {
+        std::cerr << "Cannot read " << wordList << "\n";
+        return 1;
+    }
+    Trie trie;
+    size_t words = 0;
+    double buildMs = timeMs([&] {
+        for (std::string w; std::getline(in, w);) {
+            if (!w.empty() && w.back() == '\r') {
+                w.pop_back();
+            }
+            trie.insert(w);
+            words++;
+        }
+    });
+    double saveMs = timeMs([&] {
+        trie.save(imagePath);
+    });
+    double verifyMs = timeMs([&] {
+        MappedTrie check(imagePath);
+        if (check.nodeCount() != trie.nodeCount()) {
+            throw std::runtime_error("Node count changed while writing " + imagePath);
+        }
+    });
+    std::cout << std::format("{} words, {} nodes: build {:.1f} ms  save {:.1f} ms  verify {:.1f} ms  image {:.1f} MiB\n",
+        words, trie.nodeCount(), buildMs, saveMs, verifyMs,
+        (sizeof(TrieImageHeader) + trie.nodeCount() * sizeof(TrieImageNode)) / 1048576.0);
+    return 0;
+}
+
+int query(const std::string& imagePath, const std::vector<std::string>& words) {
+    std::optional<MappedTrie> trie;
+    double openMs = timeMs([&] {
+        trie.emplace(imagePath, false);
+    });
+    std::cerr << std::format("opened {} nodes in {:.3f} ms\n", trie->nodeCount(), openMs);
+    auto answer = [&trie](const std::string& w) {
+        std::cout << w << "\t" << (trie->search(w) ? "word" : trie->startsWith(w) ? "prefix" : "absent") << "\n";
+    };
+    if (words.empty()) {
+        for (std::string w; std::getline(std::cin, w);) {
+            answer(w);
+        }
+    } else {
+        for (const std::string& w : words) {
+            answer(w);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string mode = (argc > 1) ? argv[1] : "";
+    try {
+        if (mode == "build" && argc == 4) {
+            return build(argv[2], argv[3]);
+        }
+        if (mode == "query" && argc >= 3) {
+            return query(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    std::cerr << "Usage: " << argv[0] << " build <word_list> <image>\n"
+              << "       " << argv[0] << " query <image> [word...]\n";
+    return 2;
+}
@@ -0,0 +1,489 @@
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "Trie.cpp"
+#include "RadixTrie.cpp"
+
+// Whether some word in set starts with prefix
+bool setStartsWith(const std::set<std::string>& words, const std::string& prefix) {
+    auto it = words.lower_bound(prefix);
+    return it != words.end() && it->compare(0, prefix.size(), prefix) == 0;
+}
+
+void test_basic_trie() {
+    Trie trie;
+    trie.insert("apple");
+    assert(trie.search("apple"));
+    assert(!trie.search("app"));
+    assert(trie.startsWith("app"));
+    trie.insert("app");
+    assert(trie.search("app"));
+    assert(!trie.startsWith("b"));
+    assert(trie.startsWith(""));
+    std::cout << "test_basic_trie passed.\n";
+}
+
+// Random inserts and removes over a small alphabet, so that words share long
+// prefixes and removals both keep and unlink nodes, checked against std::set
+template<typename T>
+void test_matches_set(const std::string& name) {
+    std::mt19937 rng(41);
+    T trie;
+    std::set<std::string> expected;
+    auto randomWord = [&] {
+        std::string w(rng() % 7, 'a');
+        for (char& c : w) {
+            c = static_cast<char>('a' + rng() % 4);
+        }
+        return w;
+    };
+    for (int step = 0; step < 20000; step++) {
+        std::string w = randomWord();
+        switch (rng() % 4) {
+        case 0:
+            trie.insert(w);
+            expected.insert(w);
+            break;
+        case 1:
+            assert(trie.remove(w) == (expected.erase(w) == 1));
+            break;
+        case 2:
+            assert(trie.search(w) == expected.contains(w));
+            break;
+        default:
+            assert(trie.startsWith(w) == setStartsWith(expected, w));
+            break;
+        }
+    }
+    for (const std::string& w : std::set<std::string>(expected)) {
+        assert(trie.remove(w));
+        expected.erase(w);
+        assert(!trie.search(w));
+        assert(trie.startsWith(w) == setStartsWith(expected, w));
+    }
+    // Every node but the root was unlinked
+    assert(trie.nodeCount() == 1);
+    assert(!trie.startsWith(""));
+    assert(!trie.remove("a"));
+    std::cout << "test_matches_set<" << name << "> passed.\n";
+}
+
+void test_invalid_characters() {
+    Trie trie;
+    trie.insert("ab");
+    for (std::string bad : {std::string("abC"), std::string("ab\0", 3), std::string("ab\xff")}) {
+        bool threw = false;
+        try {
+            trie.insert(bad);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+    // A rejected word leaves no nodes behind
+    assert(trie.nodeCount() == 3);
+    assert(!trie.startsWith("abc"));
+    assert(trie.search("ab"));
+    std::cout << "test_invalid_characters passed.\n";
+}
+
+void test_completions_match_brute_force() {
+    std::mt19937 rng(53);
+    WeightedTrie trie;
+    std::map<std::string, uint32_t> expected;
+    auto randomWord = [&] {
+        std::string w(1 + rng() % 5, 'a');
+        for (char& c : w) {
+            c = static_cast<char>('a' + rng() % 5);
+        }
+        return w;
+    };
+    // Ties are broken by node index, which is not visible here, so compare weights
+    // and check that every returned word has the weight at its place
+    auto check = [&](const std::string& prefix, size_t k) {
+        std::vector<uint32_t> best;
+        for (auto it = expected.lower_bound(prefix); it != expected.end() && it->first.starts_with(prefix); it++) {
+            best.push_back(it->second);
+        }
+        std::sort(best.rbegin(), best.rend());
+        best.resize(std::min(best.size(), k));
+        std::vector<std::string> got = trie.completions(prefix, k);
+        assert(got.size() == best.size());
+        std::set<std::string> distinct(got.begin(), got.end());
+        assert(distinct.size() == got.size());
+        for (size_t i = 0; i < got.size(); i++) {
+            assert(got[i].starts_with(prefix));
+            assert(expected.at(got[i]) == best[i]);
+            assert(trie.weight(got[i]) == best[i]);
+        }
+    };
+    for (int step = 0; step < 20000; step++) {
+        std::string w = randomWord();
+        int kind = rng() % 10;
+        if (kind < 4) {
+            uint32_t weight = rng() % 100;
+            trie.insert(w, weight);
+            expected[w] = weight;
+        } else if (kind < 6 && expected.contains(w)) {
+            // Lowers the weight of a present word, which must leave the caches that held it
+            uint32_t weight = expected[w] / 2;
+            trie.insert(w, weight);
+            expected[w] = weight;
+        } else if (kind < 7) {
+            trie.insert(w);
+            expected.try_emplace(w, 0);
+        } else if (kind < 8) {
+            assert(trie.remove(w) == (expected.erase(w) == 1));
+        } else {
+            std::string prefix = w.substr(0, rng() % w.size());
+            for (size_t k : {size_t(1), size_t(TOP_K), size_t(TOP_K + 3), size_t(50)}) {
+                check(prefix, k);
+            }
+        }
+    }
+    for (const auto& [w, weight] : expected) {
+        assert(trie.weight(w) == weight);
+    }
+    assert(trie.completions("zz", 3).empty());
+    assert(trie.completions("", 0).empty());
+    std::cout << "test_completions_match_brute_force passed.\n";
+}
+
+template<typename T>
+void test_prefix_range_order(const std::string& name) {
+    std::mt19937 rng(59);
+    T trie;
+    std::set<std::string> expected;
+    for (int i = 0; i < 3000; i++) {
+        std::string w(rng() % 6, 'a');
+        for (char& c : w) {
+            c = static_cast<char>('a' + rng() % 6);
+        }
+        trie.insert(w);
+        expected.insert(w);
+    }
+    for (std::string prefix : {"", "a", "bc", "fff", "zz"}) {
+        std::vector<std::string> got;
+        for (const std::string& w : trie.prefixRange(prefix)) {
+            got.push_back(w);
+        }
+        std::vector<std::string> want;
+        for (auto it = expected.lower_bound(prefix); it != expected.end() && it->starts_with(prefix); it++) {
+            want.push_back(*it);
+        }
+        assert(got == want);
+    }
+    std::cout << "test_prefix_range_order<" << name << "> passed.\n";
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+void writeFile(const std::string& path, const std::string& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+// Writes bytes as an image and checks that opening it fails with reason in the message
+void expectRejected(const std::string& path, const std::string& bytes, const std::string& reason) {
+    writeFile(path, bytes);
+    bool threw = false;
+    try {
+        MappedTrie trie(path);
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()).find(reason) != std::string::npos;
+    }
+    assert(threw);
+}
+
+template<typename T>
+void test_image_round_trip(const std::string& name) {
+    std::string path = (std::filesystem::temp_directory_path()
+        / ("TrieTest." + std::to_string(::getpid()) + ".img")).string();
+    std::mt19937 rng(61);
+    T trie;
+    auto randomWord = [&] {
+        std::string w(rng() % 8, 'a');
+        for (char& c : w) {
+            c = static_cast<char>('a' + rng() % 26);
+        }
+        return w;
+    };
+    for (int i = 0; i < 5000; i++) {
+        trie.insert(randomWord());
+    }
+    // Removed words leave free records and blocks in the arena, which the image skips
+    for (int i = 0; i < 2000; i++) {
+        trie.remove(randomWord());
+    }
+    trie.save(path);
+    {
+        MappedTrie mapped(path);
+        assert(mapped.nodeCount() == trie.nodeCount());
+        for (int i = 0; i < 20000; i++) {
+            std::string w = randomWord();
+            assert(mapped.search(w) == trie.search(w));
+            assert(mapped.startsWith(w) == trie.startsWith(w));
+        }
+        // Moving keeps the mapping alive
+        MappedTrie moved(std::move(mapped));
+        for (const std::string& w : trie.prefixRange("a")) {
+            assert(moved.search(w));
+        }
+    }
+
+    std::string image = readFile(path);
+    size_t records = sizeof(TrieImageHeader);
+    std::string bad = image;
+    bad[offsetof(TrieImageHeader, checksum)] ^= 1;
+    expectRejected(path, bad, "checksum");
+    bad = image;
+    bad[records + sizeof(TrieImageNode) + 1] ^= 0x40;
+    expectRejected(path, bad, "checksum");
+    // Skipping verification only keeps the header checks
+    {
+        MappedTrie unchecked(path, false);
+        assert(unchecked.nodeCount() == trie.nodeCount());
+    }
+    expectRejected(path, image.substr(0, image.size() - 3), "size");
+    expectRejected(path, image.substr(0, sizeof(TrieImageHeader) - 1), "Truncated");
+    expectRejected(path, "", "Truncated");
+    bad = image;
+    bad[0] ^= 1;
+    expectRejected(path, bad, "Not a trie image");
+    bad = image;
+    bad[offsetof(TrieImageHeader, version)] ^= 2;
+    expectRejected(path, bad, "Unsupported");
+    // A child block past the end, with a checksum that matches it
+    bad = image;
+    TrieImageNode root;
+    std::memcpy(&root, bad.data() + records, sizeof(root));
+    root.firstChild = UINT32_MAX - 1;
+    std::memcpy(bad.data() + records, &root, sizeof(root));
+    TrieImageHeader header;
+    std::memcpy(&header, bad.data(), sizeof(header));
+    header.checksum = fnv1a(bad.data() + records, bad.size() - records);
+    std::memcpy(bad.data(), &header, sizeof(header));
+    expectRejected(path, bad, "out of range");
+    std::filesystem::remove(path);
+
+    bool threw = false;
+    try {
+        MappedTrie missing(path);
+    } catch (const std::system_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_image_round_trip<" << name << "> passed.\n";
+}
+
+void test_concurrent_writers_and_readers() {
+    const int writers = 3;
+    const int readers = 3;
+    const int perWriter = 3000;
+    // Words use 'a'..'y', so anything with a 'z' is never present
+    std::mt19937 rng(67);
+    std::vector<std::vector<std::string>> words(writers);
+    std::set<std::string> distinct;
+    for (int t = 0; t < writers; t++) {
+        for (int i = 0; i < perWriter; i++) {
+            std::string w(1 + rng() % 6, 'a');
+            for (char& c : w) {
+                c = static_cast<char>('a' + rng() % 25);
+            }
+            words[t].push_back(w);
+            distinct.insert(w);
+        }
+    }
+    ConcurrentTrie trie;
+    // progress[t] words of writer t have been inserted
+    std::vector<std::atomic<int>> progress(writers);
+    std::atomic<size_t> added = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < writers; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < perWriter; i++) {
+                added += trie.insert(words[t][i]);
+                progress[t].store(i + 1, std::memory_order_release);
+            }
+        });
+    }
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            std::mt19937 local(71 + r);
+            std::set<std::string> seen;
+            for (int step = 0; step < 20000; step++) {
+                int t = local() % writers;
+                int done = progress[t].load(std::memory_order_acquire);
+                if (done > 0) {
+                    // An insert that has returned is seen, along with all its prefixes
+                    const std::string& w = words[t][local() % done];
+                    assert(trie.search(w));
+                    for (size_t len = 0; len <= w.size(); len++) {
+                        assert(trie.startsWith(w.substr(0, len)));
+                    }
+                }
+                const std::string& other = words[local() % writers][local() % perWriter];
+                assert(!trie.search(other + "z"));
+                assert(!trie.startsWith("z" + other));
+                // A word seen once stays seen
+                if (seen.contains(other)) {
+                    assert(trie.search(other));
+                } else if (trie.search(other)) {
+                    seen.insert(other);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    assert(added == distinct.size());
+    std::set<std::string> prefixes;
+    for (const std::string& w : distinct) {
+        assert(trie.search(w));
+        for (size_t len = 0; len <= w.size(); len++) {
+            prefixes.insert(w.substr(0, len));
+        }
+    }
+    // One node per distinct prefix, including the root for the empty one
+    assert(trie.nodeCount() == prefixes.size());
+    bool threw = false;
+    try {
+        trie.insert("zz\xff");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(!trie.startsWith("z") && trie.nodeCount() == prefixes.size());
+    std::cout << "test_concurrent_writers_and_readers passed.\n";
+}
+
+// Random byte keys from an alphabet holding 0x00 and 0xFF, so that keys with embedded
+// nulls and bytes that are negative as char are both ordered and matched correctly
+std::string randomBytes(std::mt19937& rng) {
+    static const char alphabet[] = {'\x00', '\x01', 'a', '\x7f', '\x80', '\xfe', '\xff'};
+    std::string key(rng() % 9, '\0');
+    for (char& c : key) {
+        c = alphabet[rng() % std::size(alphabet)];
+    }
+    return key;
+}
+
+// Runs random operations on trie and expected, which must hold the same keys
+void checkRadixAgainstSet(RadixTrie& trie, std::set<std::string>& expected, std::mt19937& rng, int steps) {
+    for (int step = 0; step < steps; step++) {
+        std::string key = randomBytes(rng);
+        switch (rng() % 4) {
+        case 0:
+            trie.insert(key);
+            expected.insert(key);
+            break;
+        case 1:
+            assert(trie.remove(key) == (expected.erase(key) == 1));
+            break;
+        case 2:
+            assert(trie.search(key) == expected.contains(key));
+            break;
+        default:
+            assert(trie.startsWith(key) == setStartsWith(expected, key));
+            break;
+        }
+    }
+    for (const std::string& key : expected) {
+        assert(trie.search(key));
+        for (size_t len = 0; len <= key.size(); len++) {
+            assert(trie.startsWith(key.substr(0, len)));
+        }
+    }
+}
+
+void test_radix_matches_set() {
+    std::mt19937 rng(43);
+    RadixTrie trie;
+    std::set<std::string> expected;
+    checkRadixAgainstSet(trie, expected, rng, 40000);
+    // Long keys that share prefixes, so labels outgrow the inline bytes, split and merge
+    for (int i = 0; i < 2000; i++) {
+        std::string key = std::string(20, '\xff') + randomBytes(rng) + std::string(i % 3, '\0');
+        trie.insert(key);
+        expected.insert(key);
+    }
+    checkRadixAgainstSet(trie, expected, rng, 40000);
+    for (const std::string& key : std::set<std::string>(expected)) {
+        assert(trie.remove(key));
+        expected.erase(key);
+        assert(!trie.search(key));
+        assert(trie.startsWith(key) == setStartsWith(expected, key));
+    }
+    assert(!trie.startsWith(""));
+    std::cout << "test_radix_matches_set passed.\n";
+}
+
+void test_radix_static_build_matches_set() {
+    std::mt19937 rng(47);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 5000; i++) {
+        keys.push_back(randomBytes(rng));
+    }
+    keys.push_back(std::string(30, '\x00'));
+    keys.push_back(std::string(30, '\xff'));
+    std::sort(keys.begin(), keys.end());
+    RadixTrie trie(keys);
+    std::set<std::string> expected(keys.begin(), keys.end());
+    // Queries first, on the packed breadth-first layout, then mixed updates on top of it
+    for (int step = 0; step < 20000; step++) {
+        std::string key = randomBytes(rng);
+        assert(trie.search(key) == expected.contains(key));
+        assert(trie.startsWith(key) == setStartsWith(expected, key));
+    }
+    checkRadixAgainstSet(trie, expected, rng, 40000);
+
+    RadixTrie empty(std::vector<std::string>{});
+    assert(!empty.startsWith(""));
+    RadixTrie onlyEmpty(std::vector<std::string>{""});
+    assert(onlyEmpty.search(""));
+    assert(onlyEmpty.remove(""));
+    assert(!onlyEmpty.startsWith(""));
+    bool threw = false;
+    try {
+        RadixTrie unsorted(std::vector<std::string>{"b", "a"});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_radix_static_build_matches_set passed.\n";
+}
+
+int main() {
+    test_basic_trie();
+    test_matches_set<Trie>("Trie");
+    test_matches_set<WeightedTrie>("WeightedTrie");
+    test_invalid_characters();
+    test_completions_match_brute_force();
+    test_prefix_range_order<Trie>("Trie");
+    test_prefix_range_order<WeightedTrie>("WeightedTrie");
+    test_image_round_trip<Trie>("Trie");
+    test_image_round_trip<WeightedTrie>("WeightedTrie");
+    test_concurrent_writers_and_readers();
+    test_radix_matches_set();
+    test_radix_static_build_matches_set();
+
+    std::cout << "All tests passed successfully.\n";
+    return 0;
+}
@@ -1,46 +1,51 @@
 // Implements the union-find data structure
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <cassert>
 
 class UnionFind {
 private:
-    // Stores a forest of pointers
-    std::vector<int> pointers;
-    // Stores corresponding heights of each tree
-    std::vector<int> heights;
+    // Stores a forest in one array: parents[elem] is the parent of elem,
+    // or minus the size of the component if elem is a root
+    std::vector<int> parents;
+    int components;
 
-    // Recursive implementation
+    // Iterative, with path halving: every other node on the path skips to its grandparent
     int find(int elem) {
-        if (elem == pointers[elem]) {
-            return elem;
+        while (parents[elem] >= 0) {
+            int parent = parents[elem];
+            if (parents[parent] < 0) {
+                return parent;
+            }
+            parents[elem] = parents[parent];
+            elem = parents[elem];
         }
-        // Sets the pointers
-        pointers[elem] = find(pointers[elem]);
-        return pointers[elem];
+        return elem;
     }
 
+    // Merges the smaller tree into the larger one
     void merge_roots(int r1, int r2) {
-        int h1 = heights[r1];
-        int h2 = heights[r2];
-        if (h1 < h2) {
-            // merge r1 into r2
-            pointers[r1] = r2;
-        } else if (h1 > h2) {
-            pointers[r2] = r1;
-        } else {
-            // Arbitrary choice to merge r1 into r2
-            pointers[r1] = r2;
-            heights[r2]++;
+        if (parents[r1] > parents[r2]) {
+            std::swap(r1, r2);
         }
+        parents[r1] += parents[r2];
+        parents[r2] = r1;
+        components--;
     }
 
 public:
-    UnionFind(int size) : pointers(size), heights(size, 1) {
-        for (int i = 0; i < size; i++) {
-            pointers[i] = i;
+    UnionFind(int size) : components(size) {
+        if (size < 0) {
+            throw std::invalid_argument("UnionFind size must not be negative");
         }
+        parents.assign(size, -1);
     }
     //   returns whether these two components are in the same partition
     bool same_component(const int a, const int b) {
@@ -57,42 +62,369 @@ public:
         merge_roots(r1, r2);
         return true;
     }
+    // Merges the endpoints of every edge, returns how many merges joined two components.
+    // Prefetches the entries of edges PREFETCH_DISTANCE ahead, so on a forest too big
+    // for the cache their first misses overlap with the merges before them.
+    int merge_all(const std::vector<std::pair<int, int>>& edges) {
+        constexpr size_t PREFETCH_DISTANCE = 16;
+        int merged = 0;
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (i + PREFETCH_DISTANCE < edges.size()) {
+                __builtin_prefetch(&parents[edges[i + PREFETCH_DISTANCE].first], 1);
+                __builtin_prefetch(&parents[edges[i + PREFETCH_DISTANCE].second], 1);
+            }
+            merged += merge(edges[i].first, edges[i].second);
+        }
+        return merged;
+    }
+    // Returns the number of elements in the component of elem
+    int component_size(const int elem) {
+        return -parents[find(elem)];
+    }
+    int num_components() const {
+        return components;
+    }
+    int size() const {
+        return parents.size();
+    }
 
     // function for debugging
     void printState() {
         std::cout << "Tree states: ";
-        for (int ptr : pointers) {
-            std::cout << ptr << " ";
+        for (int parent : parents) {
+            std::cout << parent << " ";
         }
         std::cout << std::endl;
-        std::cout << "Tree heights: ";
-        for (int height : heights) {
-            std::cout << height << " ";
+    }
+};
+
+// Union-find that many threads can merge into at once, without locks.
+// - parents[elem] == elem marks a root. Nodes are plain ints read and written through
+//   std::atomic_ref, and a root is linked with one CAS from itself to the other root, so
+//   a link fails if the root was linked by another thread in between, and merge retries.
+// - the root with the lower priority is linked under the other one. Priorities are a hash
+//   of the index, ties broken by the index itself, so the links form a random order and
+//   trees stay O(lg n) deep in expectation without keeping sizes.
+// - find halves the path with CAS as well. A failed CAS just means another thread already
+//   moved that node further up, so it is not retried.
+// Every merge that returns true joined two components exactly once, so the final partition
+// is the one the sequential UnionFind builds from the same pairs.
+class ConcurrentUnionFind {
+private:
+    std::vector<int> parents;
+    std::atomic<int> components;
+
+    int load(int elem) const {
+        return std::atomic_ref<int>(const_cast<int&>(parents[elem])).load(std::memory_order_acquire);
+    }
+    bool exchange(int elem, int expected, int desired) {
+        return std::atomic_ref<int>(parents[elem]).compare_exchange_strong(expected, desired, std::memory_order_acq_rel);
+    }
+    // A fixed random-looking order of the elements (murmur3 finalizer), ties broken by index
+    static bool lower_priority(int a, int b) {
+        auto mix = [](uint32_t x) {
+            x ^= x >> 16;
+            x *= 0x85ebca6bu;
+            x ^= x >> 13;
+            x *= 0xc2b2ae35u;
+            x ^= x >> 16;
+            return x;
+        };
+        uint32_t pa = mix(a);
+        uint32_t pb = mix(b);
+        return pa < pb || (pa == pb && a < b);
+    }
+    int find(int elem) {
+        while (true) {
+            int parent = load(elem);
+            if (parent == elem) {
+                return elem;
+            }
+            int grandparent = load(parent);
+            if (grandparent == parent) {
+                return parent;
+            }
+            exchange(elem, parent, grandparent);
+            elem = grandparent;
         }
-        std::cout << std::endl;
+    }
+
+public:
+    ConcurrentUnionFind(int size) : components(size) {
+        if (size < 0) {
+            throw std::invalid_argument("ConcurrentUnionFind size must not be negative");
+        }
+        parents.resize(size);
+        for (int i = 0; i < size; i++) {
+            parents[i] = i;
+        }
+    }
+    // Returns whether a and b are in the same partition. Safe to call from any thread;
+    // a merge running at the same time may or may not be seen.
+    bool same_component(const int a, const int b) {
+        while (true) {
+            int r1 = find(a);
+            int r2 = find(b);
+            if (r1 == r2) {
+                return true;
+            }
+            // r1 was still a root after both finds, so they were apart at that moment
+            if (load(r1) == r1) {
+                return false;
+            }
+        }
+    }
+    // Merges two components. Safe to call from any thread.
+    // Returns true if this call joined them, false if a,b were already in the same partition
+    bool merge(const int a, const int b) {
+        while (true) {
+            int r1 = find(a);
+            int r2 = find(b);
+            if (r1 == r2) {
+                return false;
+            }
+            if (lower_priority(r2, r1)) {
+                std::swap(r1, r2);
+            }
+            if (exchange(r1, r1, r2)) {
+                components.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    // Merges the endpoints of every edge on `threads` threads, each taking a contiguous
+    // slice of edges. Returns how many merges joined two components.
+    long long merge_all(const std::vector<std::pair<int, int>>& edges, unsigned threads = 1) {
+        threads = std::max(1u, threads);
+        std::atomic<long long> merged = 0;
+        auto mergeSlice = [&](size_t begin, size_t end) {
+            // Prefetches ahead like UnionFind::merge_all
+            constexpr size_t PREFETCH_DISTANCE = 16;
+            long long count = 0;
+            for (size_t i = begin; i < end; i++) {
+                if (i + PREFETCH_DISTANCE < end) {
+                    __builtin_prefetch(&parents[edges[i + PREFETCH_DISTANCE].first], 1);
+                    __builtin_prefetch(&parents[edges[i + PREFETCH_DISTANCE].second], 1);
+                }
+                count += merge(edges[i].first, edges[i].second);
+            }
+            merged.fetch_add(count, std::memory_order_relaxed);
+        };
+        std::vector<std::thread> workers;
+        size_t chunk = (edges.size() + threads - 1) / threads;
+        for (unsigned t = 1; t < threads && t * chunk < edges.size(); t++) {
+            workers.emplace_back(mergeSlice, t * chunk, std::min(edges.size(), (t + 1) * chunk));
+        }
+        mergeSlice(0, std::min(edges.size(), chunk));
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        return merged.load();
+    }
+    // Returns the representative of elem's component at some point during the call
+    int representative(const int elem) {
+        return find(elem);
+    }
+    int num_components() const {
+        return components.load(std::memory_order_relaxed);
+    }
+    int size() const {
+        return parents.size();
+    }
+};
+
+// Union-find whose merges can be undone, for trying out edge sets without rebuilding.
+// Same layout as UnionFind and union by size, but no path compression, so every merge
+// changes exactly two entries and find stays O(lg n). Each merge pushes what it changed
+// on an undo stack; rollback(checkpoint) pops back to an earlier checkpoint().
+class RollbackUnionFind {
+private:
+    struct Change {
+        int root;       // The root that absorbed child
+        int child;
+        int childSize;  // parents[child] before the merge
+    };
+    std::vector<int> parents;
+    std::vector<Change> history;
+    int components;
+
+public:
+    RollbackUnionFind(int size) : components(size) {
+        if (size < 0) {
+            throw std::invalid_argument("RollbackUnionFind size must not be negative");
+        }
+        parents.assign(size, -1);
+    }
+    int find(int elem) const {
+        while (parents[elem] >= 0) {
+            elem = parents[elem];
+        }
+        return elem;
+    }
+    bool same_component(const int a, const int b) const {
+        return find(a) == find(b);
+    }
+    // Merges two components
+    // Returns true if successful, false if a,b were in the same partition (nothing to undo then)
+    bool merge(const int a, const int b) {
+        int r1 = find(a);
+        int r2 = find(b);
+        if (r1 == r2) {
+            return false;
+        }
+        if (parents[r1] > parents[r2]) {
+            std::swap(r1, r2);
+        }
+        history.push_back({r1, r2, parents[r2]});
+        parents[r1] += parents[r2];
+        parents[r2] = r1;
+        components--;
+        return true;
+    }
+    // Returns a mark for the current state, to pass to rollback later
+    int checkpoint() const {
+        return history.size();
+    }
+    // Undoes every successful merge since checkpoint() returned mark
+    void rollback(int mark) {
+        if (mark < 0 || mark > (int)history.size()) {
+            throw std::out_of_range("Invalid checkpoint");
+        }
+        while ((int)history.size() > mark) {
+            Change change = history.back();
+            history.pop_back();
+            parents[change.root] -= change.childSize;
+            parents[change.child] = change.childSize;
+            components++;
+        }
+    }
+    int component_size(const int elem) const {
+        return -parents[find(elem)];
+    }
+    int num_components() const {
+        return components;
+    }
+    int size() const {
+        return parents.size();
     }
 };
 
-void runtests() {
-    UnionFind uf = UnionFind(7);
-    uf.printState();
-    assert(!uf.merge(1,1));
-    assert(uf.merge(1,2));
-    assert(uf.same_component(1,2));
-    assert(uf.merge(2,3));
-    assert(uf.same_component(1,2));
-    assert(uf.same_component(3,2));
-    assert(uf.same_component(1,3));
-    assert(uf.merge(4,5));
-    assert(uf.merge(3,5));
-    uf.printState();
-    assert(uf.same_component(1,4));
-    assert(uf.same_component(1,5));
-    assert(!uf.same_component(1,6));
-    uf.printState();
-    UnionFind invalid = UnionFind(-1);
-}
+// Offline dynamic connectivity: record edge additions, removals and connectivity
+// queries in order, then solve() answers all queries at once.
+// Each edge is alive over an interval of queries, which is split over the O(lg q) nodes
+// of a segment tree over the queries. A depth-first walk merges a node's edges on the way
+// down and rolls them back on the way up, so at each leaf the RollbackUnionFind holds
+// exactly the edges alive at that query. O((n + q + m) lg q lg n) for m edge events.
+class OfflineConnectivity {
+private:
+    struct Query {
+        int a, b;
+    };
+    int n;
+    std::vector<Query> queries;
+    // Endpoints of each removed edge, and the queries [first, last) it was alive for
+    std::vector<std::pair<int, int>> edgeEnds;
+    std::vector<std::pair<int, int>> edgeSpans;
+    // Start query of each copy of an edge currently added, by its sorted endpoints
+    std::map<std::pair<int, int>, std::vector<int>> open;
+
+    static std::pair<int, int> key(int a, int b) {
+        return {std::min(a, b), std::max(a, b)};
+    }
+    // Recorded events are only replayed in solve(), so endpoints are checked as they come in
+    void checkNodes(int a, int b) const {
+        if (a < 0 || a >= n || b < 0 || b >= n) {
+            throw std::out_of_range("OfflineConnectivity node out of range");
+        }
+    }
+    void insert(std::vector<std::vector<int>>& nodes, int node, int lo, int hi, int first, int last, int edge) const {
+        if (last <= lo || hi <= first) {
+            return;
+        }
+        if (first <= lo && hi <= last) {
+            nodes[node].push_back(edge);
+            return;
+        }
+        int mid = (lo + hi) / 2;
+        insert(nodes, 2 * node, lo, mid, first, last, edge);
+        insert(nodes, 2 * node + 1, mid, hi, first, last, edge);
+    }
+    void walk(const std::vector<std::vector<int>>& nodes, const std::vector<std::pair<int, int>>& ends,
+              int node, int lo, int hi, RollbackUnionFind& uf, std::vector<bool>& answers) const {
+        int mark = uf.checkpoint();
+        for (int edge : nodes[node]) {
+            uf.merge(ends[edge].first, ends[edge].second);
+        }
+        if (hi - lo == 1) {
+            answers[lo] = uf.same_component(queries[lo].a, queries[lo].b);
+        } else {
+            int mid = (lo + hi) / 2;
+            walk(nodes, ends, 2 * node, lo, mid, uf, answers);
+            walk(nodes, ends, 2 * node + 1, mid, hi, uf, answers);
+        }
+        uf.rollback(mark);
+    }
 
-int main() {
-    runtests();
-}
\ No newline at end of file
+public:
+    OfflineConnectivity(int size) : n(size) {
+        if (size < 0) {
+            throw std::invalid_argument("OfflineConnectivity size must not be negative");
+        }
+    }
+    // Adds an edge between a and b; the same edge may be added more than once.
+    // add_edge, remove_edge and query throw out_of_range unless 0 <= a, b < size.
+    void add_edge(const int a, const int b) {
+        checkNodes(a, b);
+        open[key(a, b)].push_back(queries.size());
+    }
+    // Removes one copy of the edge between a and b, which must have been added
+    void remove_edge(const int a, const int b) {
+        checkNodes(a, b);
+        std::pair<int, int> edge = key(a, b);
+        auto it = open.find(edge);
+        if (it == open.end()) {
+            throw std::invalid_argument("Removed an edge that was not added");
+        }
+        int first = it->second.back();
+        it->second.pop_back();
+        if (it->second.empty()) {
+            open.erase(it);
+        }
+        if (first < (int)queries.size()) {
+            edgeEnds.push_back(edge);
+            edgeSpans.push_back({first, (int)queries.size()});
+        }
+    }
+    // Asks whether a and b are connected at this point, returns the index of its answer in solve()
+    int query(const int a, const int b) {
+        checkNodes(a, b);
+        queries.push_back({a, b});
+        return queries.size() - 1;
+    }
+    // Answers every query in the order they were asked
+    std::vector<bool> solve() const {
+        int q = queries.size();
+        std::vector<bool> answers(q);
+        if (q == 0) {
+            return answers;
+        }
+        std::vector<std::pair<int, int>> ends = edgeEnds;
+        std::vector<std::pair<int, int>> spans = edgeSpans;
+        // Edges still added at the end stay alive through the last query
+        for (const auto& [edge, starts] : open) {
+            for (int first : starts) {
+                if (first < q) {
+                    ends.push_back(edge);
+                    spans.push_back({first, q});
+                }
+            }
+        }
+        std::vector<std::vector<int>> nodes(4 * q);
+        for (size_t e = 0; e < spans.size(); e++) {
+            insert(nodes, 1, 0, q, spans[e].first, spans[e].second, e);
+        }
+        RollbackUnionFind uf(n);
+        walk(nodes, ends, 1, 0, q, uf, answers);
+        return answers;
+    }
+};
@@ -0,0 +1,210 @@
+// Benchmark for UnionFind against the previous recursive two-array version.
+// Usage: ./UnionFindBench [n] [unions] [max_threads]
+//   (defaults to 100000000 elements, 100000000 unions and 32 threads)
+// Merges random pairs of elements one merge() at a time and with merge_all, then times
+// same_component on random pairs of the resulting forest.
+// Then connected components of the same random graph with ConcurrentUnionFind::merge_all
+// on 1 to max_threads threads, against the sequential UnionFind::merge_all.
+// Last, OfflineConnectivity on random add/remove/query sequences, against rebuilding a
+// UnionFind from the live edges for every query.
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "UnionFind.cpp"
+
+// The original union by height with recursive path compression, kept as the baseline
+class HandUnionFind {
+private:
+    std::vector<int> pointers;
+    std::vector<int> heights;
+
+    int find(int elem) {
+        if (elem == pointers[elem]) {
+            return elem;
+        }
+        pointers[elem] = find(pointers[elem]);
+        return pointers[elem];
+    }
+    void merge_roots(int r1, int r2) {
+        int h1 = heights[r1];
+        int h2 = heights[r2];
+        if (h1 < h2) {
+            pointers[r1] = r2;
+        } else if (h1 > h2) {
+            pointers[r2] = r1;
+        } else {
+            pointers[r1] = r2;
+            heights[r2]++;
+        }
+    }
+public:
+    HandUnionFind(int size) : pointers(size), heights(size, 1) {
+        for (int i = 0; i < size; i++) {
+            pointers[i] = i;
+        }
+    }
+    bool same_component(const int a, const int b) {
+        return (find(a) == find(b));
+    }
+    bool merge(const int a, const int b) {
+        int r1 = find(a);
+        int r2 = find(b);
+        if (r1 == r2) {
+            return false;
+        }
+        merge_roots(r1, r2);
+        return true;
+    }
+};
+
+// Returns nanoseconds per operation of fn() over ops operations
+template<typename Fn>
+double timeNs(size_t ops, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+volatile long long sink;
+
+template<typename UF>
+void run(const std::string& name, int n, const std::vector<std::pair<int, int>>& edges) {
+    UF* uf = nullptr;
+    double initNs = timeNs(n, [&] {
+        uf = new UF(n);
+    });
+    double mergeNs = timeNs(edges.size(), [&] {
+        long long merged = 0;
+        for (const auto& [a, b] : edges) {
+            merged += uf->merge(a, b);
+        }
+        sink = merged;
+    });
+    // Pairs of one edge's first end and the next edge's second, so both finds are fresh
+    double sameNs = timeNs(edges.size(), [&] {
+        long long same = 0;
+        for (size_t i = 0; i + 1 < edges.size(); i++) {
+            same += uf->same_component(edges[i].first, edges[i + 1].second);
+        }
+        sink = same;
+    });
+    std::cout << std::format("  {:<28} init {:5.2f} ns/elem  merge {:6.1f} ns ({:5.2f} s total)  same_component {:6.1f} ns\n",
+        name, initNs, mergeNs, mergeNs * edges.size() / 1e9, sameNs);
+    delete uf;
+}
+
+struct Event {
+    int kind;  // 0 adds an edge, 1 removes a live one, 2 asks a query
+    int a, b;
+};
+
+// 40% additions, 20% removals of a random live edge and 40% queries,
+// so the live edge set grows to about a fifth of the events
+std::vector<Event> randomEvents(int n, int count, std::mt19937& rng) {
+    std::vector<Event> events;
+    std::vector<std::pair<int, int>> alive;
+    for (int i = 0; i < count; i++) {
+        int roll = rng() % 5;
+        int kind = (roll < 2) ? 0 : (roll == 2) ? 1 : 2;
+        if (kind == 1 && !alive.empty()) {
+            size_t j = rng() % alive.size();
+            events.push_back({1, alive[j].first, alive[j].second});
+            alive[j] = alive.back();
+            alive.pop_back();
+        } else if (kind == 1 || kind == 0) {
+            events.push_back({0, (int)(rng() % n), (int)(rng() % n)});
+            alive.push_back({events.back().a, events.back().b});
+        } else {
+            events.push_back({2, (int)(rng() % n), (int)(rng() % n)});
+        }
+    }
+    return events;
+}
+
+double offlineNs(int n, const std::vector<Event>& events) {
+    return timeNs(events.size(), [&] {
+        OfflineConnectivity offline(n);
+        for (const Event& e : events) {
+            if (e.kind == 0) {
+                offline.add_edge(e.a, e.b);
+            } else if (e.kind == 1) {
+                offline.remove_edge(e.a, e.b);
+            } else {
+                offline.query(e.a, e.b);
+            }
+        }
+        sink = offline.solve().size();
+    });
+}
+
+void runOffline(int n, int count, bool withRebuild, std::mt19937& rng) {
+    std::vector<Event> events = randomEvents(n, count, rng);
+    std::string line = std::format("  n={:<8} events={:<8} OfflineConnectivity {:8.1f} ns/event", n, count, offlineNs(n, events));
+    if (withRebuild) {
+        double rebuildNs = timeNs(events.size(), [&] {
+            std::vector<std::pair<int, int>> alive;
+            long long connected = 0;
+            for (const Event& e : events) {
+                if (e.kind == 0) {
+                    alive.push_back({e.a, e.b});
+                } else if (e.kind == 1) {
+                    auto it = std::find(alive.begin(), alive.end(), std::make_pair(e.a, e.b));
+                    *it = alive.back();
+                    alive.pop_back();
+                } else {
+                    UnionFind uf(n);
+                    uf.merge_all(alive);
+                    connected += uf.same_component(e.a, e.b);
+                }
+            }
+            sink = connected;
+        });
+        line += std::format("  rebuild per query {:10.1f} ns/event", rebuildNs);
+    }
+    std::cout << line << "\n";
+}
+
+int main(int argc, char** argv) {
+    int n = (argc > 1) ? std::stoi(argv[1]) : 100000000;
+    size_t unions = (argc > 2) ? std::stoul(argv[2]) : 100000000;
+    unsigned maxThreads = (argc > 3) ? std::stoul(argv[3]) : 32;
+    std::mt19937 rng(42);
+    std::vector<std::pair<int, int>> edges(unions);
+    for (auto& [a, b] : edges) {
+        a = rng() % n;
+        b = rng() % n;
+    }
+    std::cout << "Random unions, n=" << n << ", " << unions << " unions\n";
+    run<HandUnionFind>("recursive, two arrays", n, edges);
+    run<UnionFind>("UnionFind", n, edges);
+    UnionFind uf(n);
+    double bulkNs = timeNs(edges.size(), [&] {
+        sink = uf.merge_all(edges);
+    });
+    std::cout << std::format("  {:<28} merge {:6.1f} ns ({:5.2f} s total), {} components left\n",
+        "UnionFind::merge_all", bulkNs, bulkNs * edges.size() / 1e9, uf.num_components());
+    std::cout << "Connected components with ConcurrentUnionFind::merge_all\n";
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        ConcurrentUnionFind concurrent(n);
+        double concurrentNs = timeNs(edges.size(), [&] {
+            sink = concurrent.merge_all(edges, threads);
+        });
+        if (concurrent.num_components() != uf.num_components()) {
+            std::cerr << "Component count differs from UnionFind\n";
+            return 1;
+        }
+        std::cout << std::format("    threads {:>2}  {:6.2f} s  {:7.2f} Medges/s  speedup over UnionFind {:5.2f}x\n",
+            threads, concurrentNs * edges.size() / 1e9, 1000 / concurrentNs, bulkNs / concurrentNs);
+    }
+    std::cout << "Offline dynamic connectivity\n";
+    runOffline(1000, 20000, true, rng);
+    runOffline(10000, 100000, true, rng);
+    runOffline(100000, 1000000, false, rng);
+    return 0;
+}
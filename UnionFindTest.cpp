@@ -0,0 +1,291 @@
+#include <iostream>
+#include <cassert>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "UnionFind.cpp"
+
+void test_basic_merges() {
+    UnionFind uf = UnionFind(7);
+    assert(!uf.merge(1,1));
+    assert(uf.merge(1,2));
+    assert(uf.same_component(1,2));
+    assert(uf.merge(2,3));
+    assert(uf.same_component(1,2));
+    assert(uf.same_component(3,2));
+    assert(uf.same_component(1,3));
+    assert(uf.merge(4,5));
+    assert(uf.merge(3,5));
+    assert(uf.same_component(1,4));
+    assert(uf.same_component(1,5));
+    assert(!uf.same_component(1,6));
+    std::cout << "test_basic_merges passed.\n";
+}
+
+void test_invalid_size() {
+    bool threw = false;
+    try {
+        UnionFind invalid = UnionFind(-1);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    UnionFind empty(0);
+    assert(empty.num_components() == 0);
+    std::cout << "test_invalid_size passed.\n";
+}
+
+void test_sizes_and_components() {
+    UnionFind uf(10);
+    assert(uf.num_components() == 10);
+    assert(uf.component_size(3) == 1);
+    uf.merge(0, 1);
+    uf.merge(2, 3);
+    uf.merge(1, 3);
+    assert(uf.num_components() == 7);
+    assert(uf.component_size(0) == 4);
+    assert(uf.component_size(3) == 4);
+    assert(uf.component_size(9) == 1);
+    assert(!uf.merge(0, 2));
+    assert(uf.num_components() == 7);
+    std::cout << "test_sizes_and_components passed.\n";
+}
+
+void test_merge_all_matches_merge() {
+    const int n = 2000;
+    std::mt19937 rng(23);
+    std::vector<std::pair<int, int>> edges(3000);
+    for (auto& [a, b] : edges) {
+        a = rng() % n;
+        b = rng() % n;
+    }
+    UnionFind bulk(n);
+    UnionFind single(n);
+    int merged = bulk.merge_all(edges);
+    int expected = 0;
+    for (const auto& [a, b] : edges) {
+        expected += single.merge(a, b);
+    }
+    assert(merged == expected);
+    assert(bulk.num_components() == n - merged);
+
+    // Labels every element by flood fill over the edges, as an oracle
+    std::vector<std::vector<int>> adjacent(n);
+    for (const auto& [a, b] : edges) {
+        adjacent[a].push_back(b);
+        adjacent[b].push_back(a);
+    }
+    std::vector<int> label(n, -1);
+    std::vector<int> labelSize;
+    for (int start = 0; start < n; start++) {
+        if (label[start] != -1) {
+            continue;
+        }
+        int id = labelSize.size();
+        labelSize.push_back(0);
+        std::vector<int> stack = {start};
+        label[start] = id;
+        while (!stack.empty()) {
+            int v = stack.back();
+            stack.pop_back();
+            labelSize[id]++;
+            for (int w : adjacent[v]) {
+                if (label[w] == -1) {
+                    label[w] = id;
+                    stack.push_back(w);
+                }
+            }
+        }
+    }
+    assert(bulk.num_components() == (int)labelSize.size());
+    for (int step = 0; step < 5000; step++) {
+        int a = rng() % n;
+        int b = rng() % n;
+        assert(bulk.same_component(a, b) == (label[a] == label[b]));
+        assert(bulk.component_size(a) == labelSize[label[a]]);
+    }
+    std::cout << "test_merge_all_matches_merge passed.\n";
+}
+
+void test_long_chain() {
+    // Ten million merges along a chain, each find walking from the newest element
+    const int n = 10000000;
+    UnionFind uf(n);
+    for (int i = 0; i + 1 < n; i++) {
+        assert(uf.merge(i + 1, i));
+    }
+    assert(uf.num_components() == 1);
+    assert(uf.component_size(0) == n);
+    assert(uf.same_component(0, n - 1));
+    std::cout << "test_long_chain passed.\n";
+}
+
+void test_concurrent_matches_sequential() {
+    const int n = 20000;
+    std::mt19937 rng(29);
+    std::vector<std::pair<int, int>> edges(18000);
+    for (auto& [a, b] : edges) {
+        a = rng() % n;
+        b = rng() % n;
+    }
+    UnionFind sequential(n);
+    int expected = sequential.merge_all(edges);
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        ConcurrentUnionFind uf(n);
+        assert(uf.merge_all(edges, threads) == expected);
+        assert(uf.num_components() == sequential.num_components());
+        for (int step = 0; step < 20000; step++) {
+            int a = rng() % n;
+            int b = rng() % n;
+            assert(uf.same_component(a, b) == sequential.same_component(a, b));
+        }
+    }
+
+    // merge and same_component called directly from threads sharing elements
+    ConcurrentUnionFind uf(n);
+    std::vector<std::thread> threads;
+    std::atomic<int> merged = 0;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t i = t; i < edges.size(); i += 4) {
+                merged += uf.merge(edges[i].first, edges[i].second);
+                uf.same_component(edges[i].first, edges[(i + 1) % edges.size()].second);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    assert(merged == expected);
+    for (int a = 0; a < n; a++) {
+        assert(uf.same_component(a, edges[a % edges.size()].first) == sequential.same_component(a, edges[a % edges.size()].first));
+    }
+    bool threw = false;
+    try {
+        ConcurrentUnionFind invalid(-1);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_concurrent_matches_sequential passed.\n";
+}
+
+void test_rollback() {
+    RollbackUnionFind uf(6);
+    assert(uf.merge(0, 1));
+    int mark = uf.checkpoint();
+    assert(uf.merge(2, 3));
+    assert(uf.merge(1, 3));
+    assert(!uf.merge(0, 2));
+    assert(uf.same_component(0, 2));
+    assert(uf.component_size(3) == 4);
+    assert(uf.num_components() == 3);
+    int inner = uf.checkpoint();
+    assert(uf.merge(4, 5));
+    uf.rollback(inner);
+    assert(!uf.same_component(4, 5));
+    assert(uf.same_component(0, 3));
+    uf.rollback(mark);
+    assert(uf.same_component(0, 1));
+    assert(!uf.same_component(0, 2));
+    assert(!uf.same_component(2, 3));
+    assert(uf.component_size(0) == 2);
+    assert(uf.component_size(2) == 1);
+    assert(uf.num_components() == 5);
+    bool threw = false;
+    try {
+        uf.rollback(uf.checkpoint() + 1);
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_rollback passed.\n";
+}
+
+void test_offline_connectivity() {
+    const int n = 30;
+    std::mt19937 rng(31);
+    OfflineConnectivity offline(n);
+    std::vector<std::pair<int, int>> alive;
+    std::vector<bool> expected;
+    for (int step = 0; step < 3000; step++) {
+        int kind = rng() % 3;
+        int a = rng() % n;
+        int b = rng() % n;
+        if (kind == 0) {
+            offline.add_edge(a, b);
+            alive.push_back({a, b});
+        } else if (kind == 1 && !alive.empty()) {
+            // Removes a random copy, sometimes with its endpoints swapped
+            size_t i = rng() % alive.size();
+            auto [x, y] = alive[i];
+            alive.erase(alive.begin() + i);
+            if (step % 2) {
+                std::swap(x, y);
+            }
+            offline.remove_edge(x, y);
+        } else {
+            UnionFind uf(n);
+            uf.merge_all(alive);
+            assert(offline.query(a, b) == (int)expected.size());
+            expected.push_back(uf.same_component(a, b));
+        }
+    }
+    assert(offline.solve() == expected);
+    // Solving again gives the same answers
+    assert(offline.solve() == expected);
+
+    OfflineConnectivity empty(3);
+    assert(empty.solve().empty());
+    bool threw = false;
+    try {
+        empty.remove_edge(0, 1);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Endpoints outside [0, size) are rejected before anything is recorded
+    OfflineConnectivity bounded(3);
+    bounded.add_edge(0, 2);
+    int before = bounded.query(0, 2);
+    for (auto [a, b] : std::vector<std::pair<int, int>>{{-1, 0}, {0, 3}, {3, 3}, {2, -5}}) {
+        int thrown = 0;
+        try {
+            bounded.add_edge(a, b);
+        } catch (const std::out_of_range&) {
+            thrown++;
+        }
+        try {
+            bounded.remove_edge(a, b);
+        } catch (const std::out_of_range&) {
+            thrown++;
+        }
+        try {
+            bounded.query(a, b);
+        } catch (const std::out_of_range&) {
+            thrown++;
+        }
+        assert(thrown == 3);
+    }
+    assert(bounded.query(1, 2) == before + 1);
+    assert(bounded.solve() == std::vector<bool>({true, false}));
+    std::cout << "test_offline_connectivity passed.\n";
+}
+
+int main() {
+    test_basic_merges();
+    test_invalid_size();
+    test_sizes_and_components();
+    test_merge_all_matches_merge();
+    test_long_chain();
+    test_concurrent_matches_sequential();
+    test_rollback();
+    test_offline_connectivity();
+
+    std::cout << "All tests passed successfully.\n";
+    return 0;
+}
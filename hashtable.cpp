@@ -1,4 +1,4 @@
-/* 
+/*
 Custom implementation of a hashtable in C++
 call it map<key, value>
 Properties:
@@ -8,87 +8,880 @@ Properties:
 
 How to resize a hashtable?
 allocate a space twice as large
-then, reallocate the entirety of the object pool
+then, move every live slot across without going through insert
+- or, in RehashMode::Incremental, keep both tables and move a few slots per call
 - how to use the hash?
 Bonus: make it templated
 Bonus: use smart pointer
-Bonus: add locks and concurrency
+Bonus: add locks and concurrency (see ConcurrentMap)
+
+Layout (Swiss-table style open addressing):
+- ctrl: one metadata byte per slot, kept apart from the keys and values.
+  A full slot stores 0x80 | the low 7 bits of its hash (H2), otherwise EMPTY (0) or DELETED.
+  EMPTY is zero so that a fresh table comes straight from calloc without a memset.
+- slots: the key/value pairs, only touched once a ctrl byte matches.
+- capacity is a power of two, so the home slot is H1 & mask instead of a modulo.
+- probing loads Group::WIDTH ctrl bytes at once and compares them all against H2
+  with SSE2 (scalar fallback otherwise), moving Group::WIDTH slots forward per step.
+- the first Group::WIDTH ctrl bytes are cloned after the end, so an unaligned
+  group load near the end of the table wraps around without a branch.
+- windows advance by exactly Group::WIDTH, so the probe order is plain linear probing.
+  That is what makes backward-shift deletion (EraseMode::BackwardShift) possible.
+
+Tombstones: erase marks the slot DELETED. Once the table is full and at least
+TOMBSTONE_THRESHOLD of it is tombstones, it is rehashed in place instead of doubled.
+In RehashMode::Incremental it is instead migrated, a few slots per call, into a
+fresh table of the same capacity.
+
+Heterogeneous lookup: with a transparent Hash and KeyEqual (the default for
+std::string keys) find/contains/erase accept std::string_view or const char*
+without building a temporary std::string.
 */
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <vector>
 #include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
-constexpr int START_SIZE = 16;
-constexpr double RESIZE_THRESHOLD = 0.7;
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+constexpr size_t START_SIZE = 16;
+// Maximum load factor of 7/8, counted in slots that are not EMPTY
+constexpr double RESIZE_THRESHOLD = 0.875;
+// Old-table slots moved per mutating call while an incremental rehash is running
+constexpr size_t MIGRATE_STEP = 16;
+// Fraction of tombstones that makes a full table rehash in place rather than grow
+constexpr double TOMBSTONE_THRESHOLD = 0.25;
+
+// Control byte values. Full slots store 0x80 | H2, so they are exactly the negative bytes
+constexpr int8_t CTRL_EMPTY = 0;
+constexpr int8_t CTRL_DELETED = 1;
+inline bool isFull(int8_t c) { return c < 0; }
+
+// A window of WIDTH control bytes, matched in parallel.
+// Each match returns a bitmask where bit i refers to the ith byte of the window.
+class Group {
+public:
+    static constexpr size_t WIDTH = 16;
+#if defined(__SSE2__)
+    explicit Group(const int8_t* pos) : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+    uint32_t match(int8_t h2) const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), bytes)));
+    }
+    uint32_t matchEmpty() const {
+        return match(CTRL_EMPTY);
+    }
+    // EMPTY and DELETED are the only non-negative control bytes
+    uint32_t matchEmptyOrDeleted() const {
+        return ~static_cast<uint32_t>(_mm_movemask_epi8(bytes)) & 0xFFFF;
+    }
+private:
+    __m128i bytes;
+#else
+    explicit Group(const int8_t* pos) {
+        std::memcpy(bytes, pos, WIDTH);
+    }
+    uint32_t match(int8_t h2) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < WIDTH; i++) {
+            mask |= static_cast<uint32_t>(bytes[i] == h2) << i;
+        }
+        return mask;
+    }
+    uint32_t matchEmpty() const {
+        return match(CTRL_EMPTY);
+    }
+    uint32_t matchEmptyOrDeleted() const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < WIDTH; i++) {
+            mask |= static_cast<uint32_t>(bytes[i] >= 0) << i;
+        }
+        return mask;
+    }
+private:
+    int8_t bytes[WIDTH];
+#endif
+};
 
-template<typename Key, typename Value>
+// std::hash is the identity for integers, which would put every
+// small key in the same few groups. Mix the bits before splitting into H1/H2.
+inline size_t mixHash(size_t h) {
+    uint64_t x = h;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+}
+
+// std::hash<std::string> and std::hash<std::string_view> agree on equal contents,
+// so the string hasher can take any string-like argument
+template<typename Key>
+struct DefaultHash : std::hash<Key> {};
+
+template<>
+struct DefaultHash<std::string> {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+// Lookups by a type other than Key need both the hasher and the comparison to opt in
+template<typename Hash, typename KeyEqual>
+concept TransparentLookup = requires {
+    typename Hash::is_transparent;
+    typename KeyEqual::is_transparent;
+};
+
+enum class RehashMode {
+    // Moves every entry into the bigger table as soon as it is needed
+    AllAtOnce,
+    // Keeps the old table alive and moves MIGRATE_STEP of its slots on every
+    // insert, erase and non-const lookup, so no call pays for the whole table
+    Incremental
+};
+
+enum class EraseMode {
+    // Marks erased slots DELETED, reclaimed by an in-place rehash once they pile up
+    Tombstone,
+    // Pulls later entries of the probe run back into the hole, so no tombstones are left
+    BackwardShift
+};
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+class ConcurrentMap;
+
+template<typename Key, typename Value, typename Hash = DefaultHash<Key>, typename KeyEqual = std::equal_to<>>
 class Map {
+    // Shards pick their Map with the top hash bits and reuse the hash for the probe
+    friend class ConcurrentMap<Key, Value, Hash, KeyEqual>;
 private:
-    size_t size;
-    size_t capacity;
-    std::vector<std::pair<Key, std::optional<Value>>> table;
-    // what if there is no std::has<Key>?
-    std::hash<Key> hasher;
-    // resizing
-    void resize(int newCapacity) {
-        if (newCapacity < START_SIZE) {
-            throw std::invalid_argument("New size is too small");
-        }
-        auto new_table = std::move(table);
-        table.clear();
-        table.resize(newCapacity);
-        for (auto [k, v] : new_table) {
-            if (v.has_value()) {
-                insert(k, v.value());
-            }
-        }
-    }
-    // Gets the corresponding slot that a key is located in
-    size_t getSlot(const Key& k) {
-        size_t hash = hasher(k) % capacity;
-        // Problem: we cannot know when to stop searching
-        // Because the table might be null.
-        while (table[hash].first != k && table[hash].first) {
-            hash = (hash + 1) % capacity;
-        }
-        return hash;
+    // Slots are constructed in place only when their ctrl byte is full
+    union Slot {
+        Slot() {}
+        ~Slot() {}
+        std::pair<Key, Value> kv;
+    };
+    struct FreeDeleter {
+        void operator()(int8_t* p) const { std::free(p); }
+    };
+    // One open-addressing array: the ctrl bytes and the slots they describe.
+    // Owns the pairs in its full slots.
+    struct Table {
+        size_t capacity = 0;
+        std::unique_ptr<int8_t[], FreeDeleter> ctrl;
+        std::unique_ptr<Slot[]> slots;
+
+        Table() = default;
+        // calloc hands back untouched zero pages, which are already all EMPTY
+        explicit Table(size_t cap) : capacity(cap),
+            ctrl(static_cast<int8_t*>(std::calloc(cap + Group::WIDTH, 1))),
+            slots(std::make_unique<Slot[]>(cap)) {
+            if (!ctrl) {
+                throw std::bad_alloc();
+            }
+        }
+        Table(Table&& other) noexcept
+            : capacity(std::exchange(other.capacity, 0)), ctrl(std::move(other.ctrl)), slots(std::move(other.slots)) {}
+        Table& operator=(Table&& other) noexcept {
+            Table temp(std::move(other));
+            std::swap(capacity, temp.capacity);
+            std::swap(ctrl, temp.ctrl);
+            std::swap(slots, temp.slots);
+            return *this;
+        }
+        ~Table() {
+            for (size_t i = 0; i < capacity; i++) {
+                if (isFull(ctrl[i])) {
+                    std::destroy_at(&slots[i].kv);
+                }
+            }
+        }
+        size_t mask() const { return capacity - 1; }
+        // Writes a control byte, keeping the cloned tail in sync
+        void setCtrl(size_t i, int8_t c) {
+            ctrl[i] = c;
+            if (i < Group::WIDTH) {
+                ctrl[capacity + i] = c;
+            }
+        }
+        // Returns the slot holding k, or capacity if k is absent
+        template<typename K>
+        size_t findSlot(const K& k, size_t hash, const KeyEqual& eq) const {
+            size_t pos = H1(hash) & mask();
+            int8_t h2 = H2(hash);
+            // Each step covers a fresh window, so the whole table takes capacity / WIDTH steps
+            for (size_t probed = 0; probed < capacity; probed += Group::WIDTH) {
+                Group g(ctrl.get() + pos);
+                for (uint32_t bits = g.match(h2); bits; bits &= bits - 1) {
+                    size_t i = (pos + std::countr_zero(bits)) & mask();
+                    if (eq(slots[i].kv.first, k)) {
+                        return i;
+                    }
+                }
+                // An empty slot ends the probe sequence: k would have been placed there
+                if (g.matchEmpty()) {
+                    return capacity;
+                }
+                pos = (pos + Group::WIDTH) & mask();
+            }
+            return capacity;
+        }
+        // Returns the first EMPTY or DELETED slot on the probe sequence of hash
+        size_t findFirstNonFull(size_t hash) const {
+            size_t pos = H1(hash) & mask();
+            while (true) {
+                Group g(ctrl.get() + pos);
+                if (uint32_t bits = g.matchEmptyOrDeleted()) {
+                    return (pos + std::countr_zero(bits)) & mask();
+                }
+                pos = (pos + Group::WIDTH) & mask();
+            }
+        }
+        // Destroys the pair in a full slot.
+        // Leaves tombstone value, the slot may sit in the middle of another key's probe sequence
+        void eraseSlot(size_t i) {
+            std::destroy_at(&slots[i].kv);
+            setCtrl(i, CTRL_DELETED);
+        }
+    };
+
+    size_t _size;
+    // Number of EMPTY slots of table that can still be filled before growing.
+    // While migrating, the entries still in oldTable are already subtracted.
+    size_t growthLeft;
+    // DELETED slots in table. They count against growthLeft until a rehash clears them.
+    size_t tombstones;
+    RehashMode mode;
+    EraseMode eraseMode;
+    Table table;
+    // Only allocated while an incremental rehash is running
+    Table oldTable;
+    // Slots of oldTable below migratePos have been moved to table
+    size_t migratePos;
+    Hash hasher;
+    KeyEqual eq;
+    // Set by ConcurrentMap, whose lock-free readers may still be probing a table this
+    // map is done with. Such tables are parked here instead of freed, and reused for
+    // later tables of the same capacity. Not copied, moved or swapped with the map.
+    // clear() still frees its tables, so ConcurrentMap never calls it.
+    std::vector<Table>* parked = nullptr;
+
+    static size_t H1(size_t hash) { return hash >> 7; }
+    static int8_t H2(size_t hash) { return static_cast<int8_t>(0x80 | (hash & 0x7F)); }
+    static size_t maxLoad(size_t capacity) {
+        return static_cast<size_t>(capacity * RESIZE_THRESHOLD);
     }
-public:
-    Map() : size(0), capacity(16), table(16) {}
-    void insert(const Key& k, const Value& v) {
-        size_t hash = getSlot(k);
-        // If I am inserting, can I use const lvalue references for k and v?
-        table[hash] = {k, v};
-        size++;
-        double load_factor = static_cast<double>(size) / capacity;
-        if (load_factor >= RESIZE_THRESHOLD) {
-            resize(2 * capacity);
+    template<typename K>
+    size_t hashOf(const K& k) const { return mixHash(hasher(k)); }
+    bool migrating() const { return oldTable.capacity != 0; }
+
+    // Returns an all-EMPTY table, reusing a parked one of the same capacity if there is one
+    Table makeTable(size_t capacity) {
+        if (parked) {
+            auto it = std::find_if(parked->begin(), parked->end(),
+                [capacity](const Table& t) { return t.capacity == capacity; });
+            if (it != parked->end()) {
+                Table reused = std::move(*it);
+                *it = std::move(parked->back());
+                parked->pop_back();
+                std::memset(reused.ctrl.get(), CTRL_EMPTY, capacity + Group::WIDTH);
+                return reused;
+            }
         }
+        return Table(capacity);
     }
-    void erase(const Key& k) {
-        size_t hash = getSlot(k);
-        if (!table[hash].second.has_value()) {
+    // Releases a table whose pairs have all been moved out
+    void dropTable(Table& t) {
+        if (parked && t.capacity != 0) {
+            parked->push_back(std::move(t));
+            return;
+        }
+        // Every slot is empty or a tombstone, so skip the destructor's scan
+        t.capacity = 0;
+        t = Table();
+    }
+
+    // Moves a full slot of src into its new home in dst and leaves a tombstone
+    // behind, so that keys still probing through src stay reachable
+    void moveSlot(Table& src, size_t i, Table& dst) {
+        size_t hash = hashOf(src.slots[i].kv.first);
+        size_t j = dst.findFirstNonFull(hash);
+        // Only table can hold tombstones that are being counted
+        if (&dst == &table && dst.ctrl[j] == CTRL_DELETED) {
+            tombstones--;
+        }
+        dst.setCtrl(j, H2(hash));
+        std::construct_at(&dst.slots[j].kv, std::move(src.slots[i].kv));
+        src.eraseSlot(i);
+    }
+    // Moves up to MIGRATE_STEP slots of oldTable, freeing it after the last one
+    void migrateStep() {
+        if (!migrating()) {
+            return;
+        }
+        size_t end = std::min(migratePos + MIGRATE_STEP, oldTable.capacity);
+        for (; migratePos < end; migratePos++) {
+            if (isFull(oldTable.ctrl[migratePos])) {
+                moveSlot(oldTable, migratePos, table);
+            }
+        }
+        if (migratePos == oldTable.capacity) {
+            dropTable(oldTable);
+        }
+    }
+    void finishMigration() {
+        while (migrating()) {
+            migrateStep();
+        }
+    }
+    // Returns the pair stored under k in either table, or nullptr if k is absent
+    template<typename K>
+    std::pair<Key, Value>* lookup(const K& k, size_t hash) const {
+        size_t i = table.findSlot(k, hash, eq);
+        if (i != table.capacity) {
+            return &table.slots[i].kv;
+        }
+        if (migrating()) {
+            i = oldTable.findSlot(k, hash, eq);
+            if (i != oldTable.capacity) {
+                return &oldTable.slots[i].kv;
+            }
+        }
+        return nullptr;
+    }
+    // Claims a non-full slot of table for a key known to be absent and returns its index.
+    // The slot's pair is left unconstructed.
+    size_t prepareInsert(size_t hash) {
+        if (growthLeft == 0) {
+            grow();
+        }
+        size_t i = table.findFirstNonFull(hash);
+        if (table.ctrl[i] == CTRL_EMPTY) {
+            growthLeft--;
+        } else {
+            tombstones--;
+        }
+        table.setCtrl(i, H2(hash));
+        _size++;
+        return i;
+    }
+    void grow() {
+        finishMigration();
+        // Mostly tombstones: reclaim them without doubling the memory.
+        // A moved-from map has no table (and no tombstones) and takes the path below.
+        bool reclaim = tombstones != 0 && tombstones >= table.capacity * TOMBSTONE_THRESHOLD;
+        if (reclaim && mode == RehashMode::AllAtOnce) {
+            rehashInPlace();
+            return;
+        }
+        size_t newCapacity = reclaim ? table.capacity : std::max(2 * table.capacity, START_SIZE);
+        if (mode == RehashMode::AllAtOnce) {
+            resize(newCapacity);
+            return;
+        }
+        // Migration moves MIGRATE_STEP slots per insert, so it needs capacity / MIGRATE_STEP
+        // inserts. A doubled table has room for at least capacity * (2 * 7/8 - 7/8) of them,
+        // a same-size one for the capacity * TOMBSTONE_THRESHOLD slots the tombstones held.
+        // Either way finishMigration() above is a no-op.
+        oldTable = std::move(table);
+        table = makeTable(newCapacity);
+        tombstones = 0;
+        migratePos = 0;
+        growthLeft = maxLoad(newCapacity) - _size;
+    }
+    // Clears every tombstone of table without allocating.
+    // Full slots are first marked DELETED to mean "not placed yet", then each one is
+    // either left where it is (already in its first non-full window), moved to an EMPTY
+    // slot, or swapped with another unplaced entry which is then processed in turn.
+    void rehashInPlace() {
+        for (size_t i = 0; i < table.capacity; i++) {
+            table.setCtrl(i, isFull(table.ctrl[i]) ? CTRL_DELETED : CTRL_EMPTY);
+        }
+        size_t mask = table.mask();
+        for (size_t i = 0; i < table.capacity; i++) {
+            if (table.ctrl[i] != CTRL_DELETED) {
+                continue;
+            }
+            size_t hash = hashOf(table.slots[i].kv.first);
+            size_t home = H1(hash) & mask;
+            size_t target = table.findFirstNonFull(hash);
+            auto window = [&](size_t pos) { return ((pos - home) & mask) / Group::WIDTH; };
+            if (window(i) == window(target)) {
+                table.setCtrl(i, H2(hash));
+            } else if (table.ctrl[target] == CTRL_EMPTY) {
+                table.setCtrl(target, H2(hash));
+                std::construct_at(&table.slots[target].kv, std::move(table.slots[i].kv));
+                std::destroy_at(&table.slots[i].kv);
+                table.setCtrl(i, CTRL_EMPTY);
+            } else {
+                table.setCtrl(target, H2(hash));
+                std::swap(table.slots[i].kv, table.slots[target].kv);
+                // Slot i now holds the unplaced entry that used to be at target
+                i--;
+            }
+        }
+        tombstones = 0;
+        growthLeft = maxLoad(table.capacity) - _size;
+    }
+    // Erases the full slot i of table by shifting later entries of its probe run back.
+    // An entry at j can fill the hole at i when i lies between its home and j,
+    // which keeps every slot between a key's home and its position full.
+    void backwardShift(size_t i) {
+        std::destroy_at(&table.slots[i].kv);
+        size_t mask = table.mask();
+        for (size_t j = (i + 1) & mask; table.ctrl[j] != CTRL_EMPTY; j = (j + 1) & mask) {
+            size_t home = H1(hashOf(table.slots[j].kv.first)) & mask;
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                std::construct_at(&table.slots[i].kv, std::move(table.slots[j].kv));
+                std::destroy_at(&table.slots[j].kv);
+                table.setCtrl(i, table.ctrl[j]);
+                i = j;
+            }
+        }
+        table.setCtrl(i, CTRL_EMPTY);
+        growthLeft++;
+    }
+    // resizing: every live pair is moved once into its new home.
+    // Keys are known to be unique, so no lookup is done on the new table.
+    void resize(size_t newCapacity) {
+        if (newCapacity < START_SIZE || (newCapacity & (newCapacity - 1)) != 0) {
+            throw std::invalid_argument("New size must be a power of two of at least START_SIZE");
+        }
+        finishMigration();
+        Table old = std::exchange(table, makeTable(newCapacity));
+        for (size_t i = 0; i < old.capacity; i++) {
+            if (isFull(old.ctrl[i])) {
+                moveSlot(old, i, table);
+            }
+        }
+        dropTable(old);
+        tombstones = 0;
+        growthLeft = maxLoad(newCapacity) - _size;
+    }
+    // Returns the value stored under k and false, or constructs the pair (k, v) and returns true
+    template<typename V>
+    std::pair<Value*, bool> tryEmplace(const Key& k, size_t hash, V&& v) {
+        migrateStep();
+        if (std::pair<Key, Value>* kv = lookup(k, hash)) {
+            return {&kv->second, false};
+        }
+        size_t i = prepareInsert(hash);
+        std::construct_at(&table.slots[i].kv, k, std::forward<V>(v));
+        return {&table.slots[i].kv.second, true};
+    }
+    template<typename K>
+    bool eraseHashed(const K& k, size_t hash) {
+        migrateStep();
+        size_t i = table.findSlot(k, hash, eq);
+        if (i != table.capacity) {
+            if (eraseMode == EraseMode::BackwardShift) {
+                backwardShift(i);
+            } else {
+                table.eraseSlot(i);
+                tombstones++;
+            }
+        } else if (migrating() && (i = oldTable.findSlot(k, hash, eq)) != oldTable.capacity) {
+            // The old table is never inserted into, so a tombstone there is harmless
+            oldTable.eraseSlot(i);
+        } else {
+            return false;
+        }
+        _size--;
+        return true;
+    }
+    template<typename K>
+    void eraseImpl(const K& k) {
+        if (!eraseHashed(k, hashOf(k))) {
             throw std::invalid_argument("Key not found");
         }
-        // Leaves tombstone value
-        table[hash] = {k, std::nullopt};
-        size--;
     }
-    // TODO: how to increment size if it's an assignment?
+    template<typename K>
+    Value* findImpl(const K& k) {
+        migrateStep();
+        std::pair<Key, Value>* kv = lookup(k, hashOf(k));
+        return kv ? &kv->second : nullptr;
+    }
+    template<typename K>
+    const Value* findImpl(const K& k) const {
+        std::pair<Key, Value>* kv = lookup(k, hashOf(k));
+        return kv ? &kv->second : nullptr;
+    }
+    // Calls fn on every stored pair
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        for (const Table* t : {&table, &oldTable}) {
+            for (size_t i = 0; i < t->capacity; i++) {
+                if (isFull(t->ctrl[i])) {
+                    fn(t->slots[i].kv);
+                }
+            }
+        }
+    }
+public:
+    explicit Map(RehashMode mode = RehashMode::AllAtOnce, EraseMode eraseMode = EraseMode::Tombstone)
+        : _size(0), growthLeft(maxLoad(START_SIZE)), tombstones(0), mode(mode), eraseMode(eraseMode),
+          table(START_SIZE), migratePos(0) {}
+    Map(const Map& other) : Map(other.mode, other.eraseMode) {
+        reserve(other._size);
+        other.forEach([this](const std::pair<Key, Value>& kv) {
+            insert(kv.first, kv.second);
+        });
+    }
+    // Leaves other empty with no table at all. It stays usable: the first insert
+    // (or reserve) allocates a START_SIZE table, lookups and erases find nothing.
+    Map(Map&& other) noexcept
+        : _size(std::exchange(other._size, 0)), growthLeft(std::exchange(other.growthLeft, 0)),
+          tombstones(std::exchange(other.tombstones, 0)), mode(other.mode), eraseMode(other.eraseMode),
+          table(std::move(other.table)), oldTable(std::move(other.oldTable)),
+          migratePos(other.migratePos), hasher(std::move(other.hasher)), eq(std::move(other.eq)) {}
+    // Copy and swap idiom: other is copied (or moved) by value
+    Map& operator=(Map other) {
+        swap(*this, other);
+        return *this;
+    }
+    friend void swap(Map& first, Map& second) {
+        using std::swap;
+        swap(first._size, second._size);
+        swap(first.growthLeft, second.growthLeft);
+        swap(first.tombstones, second.tombstones);
+        swap(first.mode, second.mode);
+        swap(first.eraseMode, second.eraseMode);
+        swap(first.table, second.table);
+        swap(first.oldTable, second.oldTable);
+        swap(first.migratePos, second.migratePos);
+        swap(first.hasher, second.hasher);
+        swap(first.eq, second.eq);
+    }
+
+    // Inserts k -> v, overwriting the value if k is already present.
+    // Returns true if a new key was added.
+    bool insert(const Key& k, const Value& v) {
+        auto [value, inserted] = tryEmplace(k, hashOf(k), v);
+        if (!inserted) {
+            *value = v;
+        }
+        return inserted;
+    }
+    void erase(const Key& k) {
+        eraseImpl(k);
+    }
+    template<typename K> requires TransparentLookup<Hash, KeyEqual>
+    void erase(const K& k) {
+        eraseImpl(k);
+    }
+    // Returns a pointer to the value of k, or nullptr if k is absent
+    Value* find(const Key& k) {
+        return findImpl(k);
+    }
+    template<typename K> requires TransparentLookup<Hash, KeyEqual>
+    Value* find(const K& k) {
+        return findImpl(k);
+    }
+    const Value* find(const Key& k) const {
+        return findImpl(k);
+    }
+    template<typename K> requires TransparentLookup<Hash, KeyEqual>
+    const Value* find(const K& k) const {
+        return findImpl(k);
+    }
+    bool contains(const Key& k) const {
+        return find(k) != nullptr;
+    }
+    template<typename K> requires TransparentLookup<Hash, KeyEqual>
+    bool contains(const K& k) const {
+        return find(k) != nullptr;
+    }
+    // Value-initializes the value if k is not present yet
     Value& operator[](const Key& k) {
-        size_t hash = getSlot(k);
-        return table[hash].second.value();
+        return *tryEmplace(k, hashOf(k), Value{}).first;
+    }
+    // Grows the table so that n keys fit without another resize
+    void reserve(size_t n) {
+        size_t newCapacity = std::max(table.capacity, START_SIZE);
+        while (maxLoad(newCapacity) < n) {
+            newCapacity *= 2;
+        }
+        if (newCapacity != table.capacity) {
+            resize(newCapacity);
+        }
+    }
+    void clear() {
+        oldTable = Table();
+        table = Table(START_SIZE);
+        _size = 0;
+        tombstones = 0;
+        growthLeft = maxLoad(START_SIZE);
+    }
+    size_t size() const {
+        return _size;
+    }
+    size_t capacity() const {
+        return table.capacity;
+    }
+    bool empty() const {
+        return _size == 0;
+    }
+    // Number of DELETED slots waiting to be reclaimed in the current table
+    size_t tombstoneCount() const {
+        return tombstones;
+    }
+    // Whether an incremental rehash still has slots left to move
+    bool rehashing() const {
+        return migrating();
     }
 };
 
-int main() {
-    Map<std::string, int> ht;
-    ht.insert("dog", 1);
-    ht.insert("cat", 2);
-    std::cout << std::format("hashtable: dog={}\n", ht["dog"]);
-    std::cout << std::format("hashtable: cat={}\n", ht["cat"]);
+// Seqlock readers read slots that a writer may be changing, and throw the result away
+// if it was. ThreadSanitizer can not tell, so it is told to skip those reads.
+#if defined(__SANITIZE_THREAD__)
+#define CONCURRENT_MAP_TSAN
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define CONCURRENT_MAP_TSAN
+#endif
+#endif
+#if defined(CONCURRENT_MAP_TSAN)
+extern "C" void AnnotateIgnoreReadsBegin(const char* file, int line);
+extern "C" void AnnotateIgnoreReadsEnd(const char* file, int line);
+#define IGNORE_READS_BEGIN() AnnotateIgnoreReadsBegin(__FILE__, __LINE__)
+#define IGNORE_READS_END() AnnotateIgnoreReadsEnd(__FILE__, __LINE__)
+#else
+#define IGNORE_READS_BEGIN()
+#define IGNORE_READS_END()
+#endif
 
-    return 0;
-}
+// Thread-safe Map split into independent shards.
+// The top bits of the hash pick a shard, and each shard is a Map with its own lock
+// and sequence counter. A shard resizes on its own while the others keep serving.
+// - writers take the shard's lock and make its sequence number odd while they change it.
+// - when Key and Value are trivially copyable, get/contains do not touch the lock: they
+//   probe the shard, copy the value out and retry if the sequence number moved (a seqlock).
+//   Readers write no shared memory, so reads of one shard scale with the reader count.
+// - readers find the tables through atomic copies of their arrays and capacities, which
+//   writers refresh before leaving. Tables a shard is done with are parked rather than
+//   freed, so a reader that raced with a resize still probes valid memory.
+// - a reader that keeps losing to writers, or one of other key and value types,
+//   falls back to a shared lock.
+template<typename Key, typename Value, typename Hash = DefaultHash<Key>, typename KeyEqual = std::equal_to<>>
+class ConcurrentMap {
+private:
+    using ShardMap = Map<Key, Value, Hash, KeyEqual>;
+    using Table = typename ShardMap::Table;
+    static constexpr bool LOCK_FREE_READS = std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Value>
+        && std::is_default_constructible_v<Key> && std::is_default_constructible_v<Value>;
+    // Optimistic reads tried before a reader takes the shared lock
+    static constexpr int READ_ATTEMPTS = 4;
+
+    // Each shard sits on its own cache line so that writing one does not
+    // invalidate its neighbours
+    using Slot = typename ShardMap::Slot;
+    struct alignas(64) Shard {
+        mutable std::shared_mutex lock;
+        // Odd while a writer is changing the shard
+        std::atomic<uint64_t> seq = 0;
+        // map.table and map.oldTable as of the last write, for readers
+        std::atomic<const int8_t*> ctrl[2] = {};
+        std::atomic<const Slot*> slots[2] = {};
+        std::atomic<size_t> capacity[2] = {};
+        ShardMap map;
+        std::vector<Table> parked;
+    };
+    // Holds a shard's lock and keeps its sequence number odd
+    class WriteGuard {
+    public:
+        explicit WriteGuard(Shard& s) : s(s), lock(s.lock) {
+            s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            // Orders the odd number before the writes to the shard
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        ~WriteGuard() {
+            publish(s);
+            s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        WriteGuard(const WriteGuard&) = delete;
+        WriteGuard& operator=(const WriteGuard&) = delete;
+    private:
+        Shard& s;
+        std::unique_lock<std::shared_mutex> lock;
+    };
+    size_t numShards;
+    int shardShift;
+    std::unique_ptr<Shard[]> shards;
+    Hash hasher;
+
+    size_t hashOf(const Key& k) const { return mixHash(hasher(k)); }
+    Shard& shardFor(size_t hash) const {
+        return shards[numShards == 1 ? 0 : hash >> shardShift];
+    }
+    // Copies the shard's table arrays and capacities where readers find them
+    static void publish(Shard& s) {
+        if constexpr (LOCK_FREE_READS) {
+            for (int t = 0; t < 2; t++) {
+                const Table& table = t == 0 ? s.map.table : s.map.oldTable;
+                s.ctrl[t].store(table.ctrl.get(), std::memory_order_relaxed);
+                s.slots[t].store(table.slots.get(), std::memory_order_relaxed);
+                s.capacity[t].store(table.capacity, std::memory_order_relaxed);
+            }
+        }
+    }
+    // One optimistic lookup of k in s, mirroring Map::lookup. Returns false if a writer
+    // got in the way. Otherwise sets found and, if value is not null, copies k's value there.
+    bool tryRead(const Shard& s, const Key& k, size_t hash, bool& found, Value* value) const {
+        uint64_t before = s.seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            return false;
+        }
+        const int8_t* ctrl[2];
+        const Slot* slots[2];
+        size_t capacity[2];
+        for (int t = 0; t < 2; t++) {
+            ctrl[t] = s.ctrl[t].load(std::memory_order_relaxed);
+            slots[t] = s.slots[t].load(std::memory_order_relaxed);
+            capacity[t] = s.capacity[t].load(std::memory_order_relaxed);
+        }
+        // A capacity from one table and arrays from another could send the probe past the
+        // end of the arrays, so they are checked before use. Parked tables keep them valid.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != before) {
+            return false;
+        }
+        found = false;
+        int8_t h2 = ShardMap::H2(hash);
+        IGNORE_READS_BEGIN();
+        for (int t = 0; t < 2 && !found; t++) {
+            size_t mask = capacity[t] - 1;
+            size_t pos = ShardMap::H1(hash) & mask;
+            for (size_t probed = 0; probed < capacity[t] && !found; probed += Group::WIDTH) {
+                Group g(ctrl[t] + pos);
+                for (uint32_t bits = g.match(h2); bits; bits &= bits - 1) {
+                    size_t i = (pos + std::countr_zero(bits)) & mask;
+                    // Copies, as the slot may change under us. Key and Value are trivially copyable.
+                    Key key;
+                    std::memcpy(&key, &slots[t][i].kv.first, sizeof(Key));
+                    if (s.map.eq(key, k)) {
+                        if (value) {
+                            std::memcpy(value, &slots[t][i].kv.second, sizeof(Value));
+                        }
+                        found = true;
+                        break;
+                    }
+                }
+                if (g.matchEmpty()) {
+                    break;
+                }
+                pos = (pos + Group::WIDTH) & mask;
+            }
+        }
+        IGNORE_READS_END();
+        // Orders the reads above before the second look at the sequence number
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.seq.load(std::memory_order_relaxed) == before;
+    }
+public:
+    // numShards is rounded up to a power of two
+    explicit ConcurrentMap(size_t shardCount = 64, RehashMode mode = RehashMode::AllAtOnce)
+        : numShards(std::bit_ceil(std::max<size_t>(shardCount, 1))),
+          shardShift(64 - std::countr_zero(numShards)), shards(std::make_unique<Shard[]>(numShards)) {
+        for (size_t i = 0; i < numShards; i++) {
+            shards[i].map = ShardMap(mode);
+            if constexpr (LOCK_FREE_READS) {
+                shards[i].map.parked = &shards[i].parked;
+            }
+            publish(shards[i]);
+        }
+    }
+
+    // Inserts k -> v, overwriting the value if k is already present.
+    // Returns true if a new key was added.
+    bool insert(const Key& k, const Value& v) {
+        size_t hash = hashOf(k);
+        Shard& s = shardFor(hash);
+        WriteGuard guard(s);
+        auto [value, inserted] = s.map.tryEmplace(k, hash, v);
+        if (!inserted) {
+            *value = v;
+        }
+        return inserted;
+    }
+    // Returns whether k was present. Unlike Map::erase this does not throw,
+    // as another thread may have erased k between a contains() and the erase.
+    bool erase(const Key& k) {
+        size_t hash = hashOf(k);
+        Shard& s = shardFor(hash);
+        WriteGuard guard(s);
+        return s.map.eraseHashed(k, hash);
+    }
+    // Returns a copy of the value, references would outlive the read
+    std::optional<Value> get(const Key& k) const {
+        size_t hash = hashOf(k);
+        Shard& s = shardFor(hash);
+        if constexpr (LOCK_FREE_READS) {
+            for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+                Value value;
+                bool found;
+                if (tryRead(s, k, hash, found, &value)) {
+                    return found ? std::optional<Value>(value) : std::nullopt;
+                }
+            }
+        }
+        std::shared_lock guard(s.lock);
+        const std::pair<Key, Value>* kv = s.map.lookup(k, hash);
+        if (!kv) {
+            return std::nullopt;
+        }
+        return kv->second;
+    }
+    bool contains(const Key& k) const {
+        size_t hash = hashOf(k);
+        Shard& s = shardFor(hash);
+        if constexpr (LOCK_FREE_READS) {
+            for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+                bool found;
+                if (tryRead(s, k, hash, found, nullptr)) {
+                    return found;
+                }
+            }
+        }
+        std::shared_lock guard(s.lock);
+        return s.map.lookup(k, hash) != nullptr;
+    }
+    // Applies fn to the value of k under the shard's write lock,
+    // value-initializing it first if k is absent
+    template<typename Fn>
+    void update(const Key& k, Fn fn) {
+        size_t hash = hashOf(k);
+        Shard& s = shardFor(hash);
+        WriteGuard guard(s);
+        fn(*s.map.tryEmplace(k, hash, Value{}).first);
+    }
+    // Shards are read one after another, so this is only a snapshot
+    // if no writer runs concurrently
+    size_t size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < numShards; i++) {
+            std::shared_lock guard(shards[i].lock);
+            total += shards[i].map.size();
+        }
+        return total;
+    }
+    size_t shardCount() const {
+        return numShards;
+    }
+};
@@ -0,0 +1,249 @@
+// Throughput benchmark for Map against the standard library (and abseil if available).
+// Usage: ./hashtableBench [num_keys] [max_threads]
+//   num_keys defaults to 1000000, the target workload is 10000000.
+//   max_threads bounds the ConcurrentMap scaling run (defaults to 32).
+// Also prints per-insert latency histograms for both RehashModes, insert/erase churn
+// for both EraseModes, and string_view against std::string lookups.
+// Build with -DBENCH_WITH_ABSL and link abseil to add absl::flat_hash_map to the table.
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <bit>
+
+#include "hashtable.cpp"
+#ifdef BENCH_WITH_ABSL
+#include "absl/container/flat_hash_map.h"
+#endif
+
+// Returns nanoseconds per operation of fn() over ops operations
+template<typename Fn>
+double timeNs(size_t ops, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+// Keeps the optimizer from dropping lookups whose result is unused
+volatile size_t sink;
+
+// Adapters so that every map is driven through the same calls
+template<typename Key, typename Value>
+struct MapAdapter {
+    Map<Key, Value> m;
+    void insert(const Key& k, const Value& v) { m.insert(k, v); }
+    bool contains(const Key& k) const { return m.find(k) != nullptr; }
+    void erase(const Key& k) { m.erase(k); }
+};
+
+template<typename Std>
+struct StdAdapter {
+    Std m;
+    template<typename K, typename V>
+    void insert(const K& k, const V& v) { m.insert_or_assign(k, v); }
+    template<typename K>
+    bool contains(const K& k) const { return m.find(k) != m.end(); }
+    template<typename K>
+    void erase(const K& k) { m.erase(k); }
+};
+
+template<typename Adapter, typename Key>
+void runWorkload(const std::string& name, const std::vector<Key>& keys, const std::vector<Key>& misses) {
+    Adapter a;
+    size_t n = keys.size();
+    double insertNs = timeNs(n, [&] {
+        for (size_t i = 0; i < n; i++) {
+            a.insert(keys[i], i);
+        }
+    });
+    double hitNs = timeNs(n, [&] {
+        size_t found = 0;
+        for (const Key& k : keys) {
+            found += a.contains(k);
+        }
+        sink = found;
+    });
+    double missNs = timeNs(n, [&] {
+        size_t found = 0;
+        for (const Key& k : misses) {
+            found += a.contains(k);
+        }
+        sink = found;
+    });
+    double eraseNs = timeNs(n, [&] {
+        for (const Key& k : keys) {
+            a.erase(k);
+        }
+    });
+    std::cout << std::format("  {:<22} insert {:7.1f}  find-hit {:7.1f}  find-miss {:7.1f}  erase {:7.1f}  (ns/op)\n",
+        name, insertNs, hitNs, missNs, eraseNs);
+}
+
+template<typename Key>
+void runAll(const std::string& label, const std::vector<Key>& keys, const std::vector<Key>& misses) {
+    std::cout << label << " keys, n=" << keys.size() << "\n";
+    runWorkload<MapAdapter<Key, size_t>>("Map", keys, misses);
+    runWorkload<StdAdapter<std::unordered_map<Key, size_t>>>("std::unordered_map", keys, misses);
+#ifdef BENCH_WITH_ABSL
+    runWorkload<StdAdapter<absl::flat_hash_map<Key, size_t>>>("absl::flat_hash_map", keys, misses);
+#endif
+}
+
+// Read-mostly scaling run: each thread does 90% get / 10% insert on a shared
+// ConcurrentMap preloaded with n keys. Reports aggregate throughput per thread count.
+void runConcurrent(const std::vector<uint64_t>& keys, size_t maxThreads) {
+    constexpr size_t OPS_PER_THREAD = 1000000;
+    std::cout << "ConcurrentMap 90/10 get/insert, n=" << keys.size() << "\n";
+    ConcurrentMap<uint64_t, uint64_t> cm(256);
+    for (uint64_t k : keys) {
+        cm.insert(k, k);
+    }
+    double baseline = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&cm, &keys, t] {
+                std::mt19937_64 rng(t);
+                size_t found = 0;
+                for (size_t op = 0; op < OPS_PER_THREAD; op++) {
+                    uint64_t k = keys[rng() % keys.size()];
+                    if (op % 10 == 0) {
+                        cm.insert(k, op);
+                    } else {
+                        found += cm.contains(k);
+                    }
+                }
+                sink = found;
+            });
+        }
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        double mops = threads * OPS_PER_THREAD / std::chrono::duration<double, std::micro>(end - start).count();
+        if (threads == 1) {
+            baseline = mops;
+        }
+        std::cout << std::format("  threads {:>2}  {:8.2f} Mops/s  speedup {:5.2f}x\n", threads, mops, mops / baseline);
+    }
+}
+
+// Long-running insert/erase churn over a sliding window of live keys,
+// followed by lookups that have to probe past whatever the churn left behind
+void runChurn(const std::vector<uint64_t>& keys, EraseMode eraseMode, const std::string& name) {
+    size_t window = keys.size() / 4;
+    Map<uint64_t, uint64_t> m(RehashMode::AllAtOnce, eraseMode);
+    double churnNs = timeNs(keys.size(), [&] {
+        for (size_t i = 0; i < keys.size(); i++) {
+            m.insert(keys[i], i);
+            if (i >= window) {
+                m.erase(keys[i - window]);
+            }
+        }
+    });
+    double findNs = timeNs(keys.size(), [&] {
+        size_t found = 0;
+        for (uint64_t k : keys) {
+            found += m.contains(k);
+        }
+        sink = found;
+    });
+    std::cout << std::format("  {:<22} churn {:7.1f}  find {:7.1f}  (ns/op)  capacity {}  tombstones {}\n",
+        name, churnNs, findNs, m.capacity(), m.tombstoneCount());
+}
+
+// Looking a std::string key up through std::string_view skips building a temporary string
+void runHeterogeneous(const std::vector<std::string>& keys) {
+    Map<std::string, size_t> m;
+    for (size_t i = 0; i < keys.size(); i++) {
+        m.insert(keys[i], i);
+    }
+    std::vector<const char*> raw(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        raw[i] = keys[i].c_str();
+    }
+    double viaString = timeNs(keys.size(), [&] {
+        size_t found = 0;
+        for (const char* k : raw) {
+            found += m.contains(std::string(k));
+        }
+        sink = found;
+    });
+    double viaView = timeNs(keys.size(), [&] {
+        size_t found = 0;
+        for (const char* k : raw) {
+            found += m.contains(std::string_view(k));
+        }
+        sink = found;
+    });
+    std::cout << std::format("  lookup from const char*: via std::string {:7.1f}  via std::string_view {:7.1f}  (ns/op)\n",
+        viaString, viaView);
+}
+
+// Times every insert on its own and prints a log2 latency histogram with tail percentiles.
+// All-at-once resizes show up as a handful of inserts in the millisecond buckets.
+void runLatency(const std::vector<uint64_t>& keys, RehashMode mode, const std::string& name) {
+    Map<uint64_t, uint64_t> m(mode);
+    std::vector<uint64_t> latencies(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto start = std::chrono::steady_clock::now();
+        m.insert(keys[i], i);
+        auto end = std::chrono::steady_clock::now();
+        latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    }
+    // Bucket b counts latencies in [2^(b-1), 2^b) ns
+    std::vector<size_t> buckets(64, 0);
+    for (uint64_t ns : latencies) {
+        buckets[std::bit_width(ns)]++;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    std::cout << std::format("Insert latency, {} (ns): p50 {}  p99 {}  p999 {}  max {}\n",
+        name, percentile(0.5), percentile(0.99), percentile(0.999), latencies.back());
+    for (size_t b = 0; b < buckets.size(); b++) {
+        if (buckets[b]) {
+            std::cout << std::format("  < {:>10} ns  {:>10}\n", 1ULL << b, buckets[b]);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t n = (argc > 1) ? std::stoull(argv[1]) : 1000000;
+    size_t maxThreads = (argc > 2) ? std::stoull(argv[2]) : 32;
+    std::mt19937_64 rng(12345);
+
+    // Odd keys are inserted, even keys are guaranteed misses
+    std::vector<uint64_t> intKeys(n), intMisses(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t r = rng();
+        intKeys[i] = r | 1;
+        intMisses[i] = r & ~1ULL;
+    }
+    runAll("uint64_t", intKeys, intMisses);
+    runLatency(intKeys, RehashMode::AllAtOnce, "all-at-once rehash");
+    runLatency(intKeys, RehashMode::Incremental, "incremental rehash");
+    std::cout << "Insert/erase churn, uint64_t keys\n";
+    runChurn(intKeys, EraseMode::Tombstone, "tombstones");
+    runChurn(intKeys, EraseMode::BackwardShift, "backward shift");
+    runConcurrent(intKeys, maxThreads);
+
+    std::vector<std::string> strKeys(n), strMisses(n);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t r = rng();
+        strKeys[i] = "key:" + std::to_string(r) + ":present";
+        strMisses[i] = "key:" + std::to_string(r) + ":absent";
+    }
+    runAll("std::string", strKeys, strMisses);
+    runHeterogeneous(strKeys);
+    return 0;
+}
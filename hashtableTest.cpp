@@ -0,0 +1,416 @@
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <random>
+#include <thread>
+
+#include "hashtable.cpp"
+
+void test_basic_insert_and_lookup() {
+    Map<std::string, int> ht;
+    ht.insert("dog", 1);
+    ht.insert("cat", 2);
+    assert(ht["dog"] == 1);
+    assert(ht["cat"] == 2);
+    assert(ht.size() == 2);
+    assert(ht.contains("dog"));
+    assert(!ht.contains("cow"));
+    assert(ht.find("cow") == nullptr);
+    std::cout << "test_basic_insert_and_lookup passed.\n";
+}
+
+void test_overwrite_does_not_grow() {
+    Map<std::string, int> ht;
+    assert(ht.insert("dog", 1));
+    assert(!ht.insert("dog", 5));
+    assert(ht.size() == 1);
+    assert(ht["dog"] == 5);
+    std::cout << "test_overwrite_does_not_grow passed.\n";
+}
+
+void test_operator_brackets_value_initializes() {
+    Map<std::string, int> ht;
+    assert(ht["missing"] == 0);
+    assert(ht.size() == 1);
+    ht["missing"] += 3;
+    assert(ht["missing"] == 3);
+    std::cout << "test_operator_brackets_value_initializes passed.\n";
+}
+
+void test_erase() {
+    Map<int, int> ht;
+    for (int i = 0; i < 100; i++) {
+        ht.insert(i, i * i);
+    }
+    for (int i = 0; i < 100; i += 2) {
+        ht.erase(i);
+    }
+    assert(ht.size() == 50);
+    for (int i = 0; i < 100; i++) {
+        assert(ht.contains(i) == (i % 2 == 1));
+    }
+    bool threw = false;
+    try {
+        ht.erase(0);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "test_erase passed.\n";
+}
+
+void test_resize_keeps_entries() {
+    Map<int, int> ht;
+    for (int i = 0; i < 10000; i++) {
+        ht.insert(i, -i);
+    }
+    assert(ht.size() == 10000);
+    // Capacity stays a power of two
+    assert((ht.capacity() & (ht.capacity() - 1)) == 0);
+    for (int i = 0; i < 10000; i++) {
+        assert(*ht.find(i) == -i);
+    }
+    std::cout << "test_resize_keeps_entries passed.\n";
+}
+
+void test_copy_and_move() {
+    Map<std::string, int> ht;
+    for (int i = 0; i < 100; i++) {
+        ht.insert(std::to_string(i), i);
+    }
+    Map<std::string, int> copy(ht);
+    Map<std::string, int> moved(std::move(ht));
+    assert(copy.size() == 100 && moved.size() == 100);
+    for (int i = 0; i < 100; i++) {
+        assert(copy[std::to_string(i)] == i);
+        assert(moved[std::to_string(i)] == i);
+    }
+    std::cout << "test_copy_and_move passed.\n";
+}
+
+// A moved-from map has no table until it is used again
+void test_moved_from_is_reusable(RehashMode mode) {
+    Map<std::string, int> ht(mode);
+    for (int i = 0; i < 100; i++) {
+        ht.insert(std::to_string(i), i);
+    }
+    Map<std::string, int> moved(std::move(ht));
+    assert(ht.empty());
+    assert(!ht.contains("1") && ht.find("1") == nullptr);
+    bool threw = false;
+    try {
+        ht.erase("1");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    Map<std::string, int> copyOfEmpty(ht);
+    assert(copyOfEmpty.empty());
+    assert(ht.insert("a", 1));
+    assert(ht["b"] == 0);
+    for (int i = 0; i < 1000; i++) {
+        ht.insert(std::to_string(i), i);
+    }
+    assert(ht.size() == 1002 && ht["999"] == 999);
+
+    // reserve straight after a move, and the source of a move assignment
+    Map<std::string, int> reserved(std::move(moved));
+    moved.reserve(500);
+    size_t capacity = moved.capacity();
+    assert(capacity >= 512);
+    for (int i = 0; i < 500; i++) {
+        moved.insert(std::to_string(i), i);
+    }
+    assert(moved.capacity() == capacity);
+    Map<std::string, int> target;
+    target = std::move(moved);
+    assert(target.size() == 500);
+    moved.insert("x", 7);
+    moved.reserve(0);
+    assert(moved.size() == 1 && moved["x"] == 7);
+    moved = std::move(reserved);
+    assert(moved.size() == 100 && moved["42"] == 42);
+    reserved.clear();
+    reserved.insert("y", 8);
+    assert(reserved.size() == 1);
+    std::cout << "test_moved_from_is_reusable passed.\n";
+}
+
+// Random insert/erase churn checked against std::unordered_map
+void test_matches_unordered_map(RehashMode mode, EraseMode eraseMode) {
+    Map<int, int> ht(mode, eraseMode);
+    std::unordered_map<int, int> expected;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> keys(0, 5000);
+    for (int step = 0; step < 200000; step++) {
+        int k = keys(rng);
+        if (rng() % 3 == 0) {
+            if (expected.erase(k)) {
+                ht.erase(k);
+            }
+        } else {
+            ht.insert(k, step);
+            expected[k] = step;
+        }
+    }
+    assert(ht.size() == expected.size());
+    for (int k = 0; k <= 5000; k++) {
+        auto it = expected.find(k);
+        const int* v = ht.find(k);
+        assert((it == expected.end()) == (v == nullptr));
+        assert(!v || *v == it->second);
+    }
+    if (eraseMode == EraseMode::BackwardShift) {
+        assert(ht.tombstoneCount() == 0);
+    }
+    std::cout << "test_matches_unordered_map passed.\n";
+}
+
+void test_incremental_rehash() {
+    Map<std::string, int> ht(RehashMode::Incremental);
+    // START_SIZE * 7/8 = 14 keys fit before the first grow
+    for (int i = 0; i < 15; i++) {
+        ht.insert(std::to_string(i), i);
+    }
+    assert(ht.rehashing());
+    assert(ht.capacity() == 2 * START_SIZE);
+    // Keys are reachable in both tables while the migration runs
+    for (int i = 0; i < 15; i++) {
+        assert(ht.contains(std::to_string(i)));
+    }
+    // Non-const lookups move MIGRATE_STEP slots each
+    ht.find("0");
+    assert(!ht.rehashing());
+    for (int i = 15; i < 100000; i++) {
+        ht.insert(std::to_string(i), i);
+        if (i % 3 == 0) {
+            ht.erase(std::to_string(i / 2));
+        }
+    }
+    Map<std::string, int> copy(ht);
+    for (int i = 0; i < 100000; i++) {
+        const int* v = ht.find(std::to_string(i));
+        assert(v == nullptr || *v == i);
+        assert(copy.contains(std::to_string(i)) == (v != nullptr));
+    }
+    assert(copy.size() == ht.size());
+    std::cout << "test_incremental_rehash passed.\n";
+}
+
+// A sliding window of live keys: without reclaiming tombstones the table would keep doubling
+void test_tombstones_are_reclaimed() {
+    Map<int, int> ht;
+    for (int i = 0; i < 1000; i++) {
+        ht.insert(i, i);
+    }
+    size_t capacity = ht.capacity();
+    for (int i = 1000; i < 200000; i++) {
+        ht.insert(i, i);
+        ht.erase(i - 1000);
+    }
+    assert(ht.capacity() == capacity);
+    assert(ht.tombstoneCount() < capacity);
+    assert(ht.size() == 1000);
+    for (int i = 199000; i < 200000; i++) {
+        assert(*ht.find(i) == i);
+    }
+    assert(!ht.contains(198999));
+    std::cout << "test_tombstones_are_reclaimed passed.\n";
+}
+
+// Counts every hash computed, to bound the work a single call does
+size_t hashCalls = 0;
+struct CountingHash {
+    size_t operator()(int k) const {
+        hashCalls++;
+        return std::hash<int>{}(k);
+    }
+};
+
+// Returns the most hashes any single insert or erase of a sliding window computed
+size_t maxHashesPerCall(RehashMode mode) {
+    Map<int, int, CountingHash> ht(mode);
+    for (int i = 0; i < 1000; i++) {
+        ht.insert(i, i);
+    }
+    size_t capacity = ht.capacity();
+    size_t worst = 0;
+    for (int i = 1000; i < 200000; i++) {
+        hashCalls = 0;
+        ht.insert(i, i);
+        worst = std::max(worst, hashCalls);
+        hashCalls = 0;
+        ht.erase(i - 1000);
+        worst = std::max(worst, hashCalls);
+    }
+    // Tombstones were reclaimed at the same capacity, not by growing
+    assert(ht.capacity() == capacity);
+    assert(ht.size() == 1000);
+    for (int i = 199000; i < 200000; i++) {
+        assert(*ht.find(i) == i);
+    }
+    assert(!ht.contains(198999));
+    return worst;
+}
+
+void test_incremental_tombstone_reclaim_is_bounded() {
+    // The key itself plus at most MIGRATE_STEP migrated slots
+    assert(maxHashesPerCall(RehashMode::Incremental) <= 1 + MIGRATE_STEP);
+    // An in-place rehash rehashes every live key in one call
+    assert(maxHashesPerCall(RehashMode::AllAtOnce) >= 1000);
+    std::cout << "test_incremental_tombstone_reclaim_is_bounded passed.\n";
+}
+
+void test_heterogeneous_lookup() {
+    Map<std::string, int> ht;
+    ht.insert("dog", 1);
+    ht.insert("cat", 2);
+    std::string_view dog = "dog";
+    assert(*ht.find(dog) == 1);
+    assert(ht.contains("cat"));
+    assert(!ht.contains(std::string_view("cow")));
+    ht.erase(std::string_view("cat"));
+    assert(!ht.contains("cat"));
+    assert(ht.size() == 1);
+    std::cout << "test_heterogeneous_lookup passed.\n";
+}
+
+// Writers on disjoint key ranges race with readers of the same keys
+void test_concurrent_map() {
+    ConcurrentMap<int, int> cm(8);
+    assert(cm.shardCount() == 8);
+    constexpr int THREADS = 4;
+    constexpr int PER_THREAD = 20000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&cm, t] {
+            for (int i = t * PER_THREAD; i < (t + 1) * PER_THREAD; i++) {
+                cm.insert(i, i);
+                cm.update(i, [](int& v) { v++; });
+                // A reader of another thread's range only ever sees complete values
+                std::optional<int> other = cm.get((i + PER_THREAD) % (THREADS * PER_THREAD));
+                assert(!other || *other >= 0);
+            }
+        });
+    }
+    for (std::thread& th : threads) {
+        th.join();
+    }
+    assert(cm.size() == THREADS * PER_THREAD);
+    for (int i = 0; i < THREADS * PER_THREAD; i++) {
+        assert(cm.get(i) == i + 1);
+    }
+    assert(cm.erase(0));
+    assert(!cm.erase(0));
+    assert(!cm.contains(0));
+    std::cout << "test_concurrent_map passed.\n";
+}
+
+// A value written as two halves, so a torn copy shows up as b != ~a
+struct Halves {
+    uint64_t a;
+    uint64_t b;
+};
+
+// Lock-free readers race with writers that overwrite, insert, erase and resize.
+// Keys present for the whole run must always be found, with a whole value.
+void test_concurrent_readers_during_resizes(RehashMode mode) {
+    constexpr uint64_t STABLE = 1000;
+    constexpr uint64_t PER_WRITER = 30000;
+    ConcurrentMap<uint64_t, Halves> cm(4, mode);
+    for (uint64_t k = 0; k < STABLE; k++) {
+        cm.insert(k, {k, ~k});
+    }
+    std::atomic<int> writing = 2;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 2; t++) {
+        threads.emplace_back([&cm, &writing, t] {
+            uint64_t first = STABLE + t * PER_WRITER;
+            for (uint64_t k = first; k < first + PER_WRITER; k++) {
+                cm.insert(k, {k, ~k});
+                uint64_t stable = k % STABLE;
+                cm.insert(stable, {stable + k * STABLE, ~(stable + k * STABLE)});
+                if (k % 3 == 0) {
+                    cm.erase(k - 1);
+                }
+            }
+            writing--;
+        });
+    }
+    for (int t = 0; t < 2; t++) {
+        threads.emplace_back([&cm, &writing, t] {
+            std::mt19937_64 rng(t);
+            while (writing > 0) {
+                uint64_t k = rng() % STABLE;
+                std::optional<Halves> v = cm.get(k);
+                assert(v && v->b == ~v->a && v->a % STABLE == k);
+                assert(cm.contains(k));
+                uint64_t other = STABLE + rng() % (2 * PER_WRITER);
+                if (std::optional<Halves> w = cm.get(other)) {
+                    assert(w->a == other && w->b == ~other);
+                }
+            }
+        });
+    }
+    for (std::thread& th : threads) {
+        th.join();
+    }
+    for (uint64_t k = STABLE; k < STABLE + 2 * PER_WRITER; k++) {
+        bool erased = (k + 1) % 3 == 0 && k + 1 < STABLE + 2 * PER_WRITER && k + 1 != STABLE + PER_WRITER;
+        assert(cm.contains(k) == !erased);
+    }
+    std::cout << "test_concurrent_readers_during_resizes passed.\n";
+}
+
+// Keys that are not trivially copyable take the shared lock instead
+void test_concurrent_map_string_keys() {
+    ConcurrentMap<std::string, int> cm(2);
+    std::thread writer([&cm] {
+        for (int i = 0; i < 20000; i++) {
+            cm.insert(std::to_string(i), i);
+        }
+    });
+    std::thread reader([&cm] {
+        for (int i = 0; i < 20000; i++) {
+            std::optional<int> v = cm.get(std::to_string(i / 2));
+            assert(!v || *v == i / 2);
+        }
+    });
+    writer.join();
+    reader.join();
+    assert(cm.size() == 20000 && cm.get("19999") == 19999);
+    std::cout << "test_concurrent_map_string_keys passed.\n";
+}
+
+int main() {
+    test_basic_insert_and_lookup();
+    test_overwrite_does_not_grow();
+    test_operator_brackets_value_initializes();
+    test_erase();
+    test_resize_keeps_entries();
+    test_copy_and_move();
+    test_moved_from_is_reusable(RehashMode::AllAtOnce);
+    test_moved_from_is_reusable(RehashMode::Incremental);
+    test_matches_unordered_map(RehashMode::AllAtOnce, EraseMode::Tombstone);
+    test_matches_unordered_map(RehashMode::Incremental, EraseMode::Tombstone);
+    test_matches_unordered_map(RehashMode::AllAtOnce, EraseMode::BackwardShift);
+    test_matches_unordered_map(RehashMode::Incremental, EraseMode::BackwardShift);
+    test_incremental_rehash();
+    test_tombstones_are_reclaimed();
+    test_incremental_tombstone_reclaim_is_bounded();
+    test_heterogeneous_lookup();
+    test_concurrent_map();
+    test_concurrent_readers_during_resizes(RehashMode::AllAtOnce);
+    test_concurrent_readers_during_resizes(RehashMode::Incremental);
+    test_concurrent_map_string_keys();
+
+    std::cout << "All tests passed successfully.\n";
+    return 0;
+}